@@ -0,0 +1,81 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include "lib/Blob.hpp"
+
+using namespace std;
+
+/*
+c++ -o bm -Wall -std=c++14 -O3 bm_blob.cpp
+
+benchmark of Blob's serialization throughput: contiguous data (strings, vectors
+of fundamentals, native arrays) is appended/restored in bulk; element-wise path
+(as it would be for a generic container) is measured for a reference
+*/
+
+#define DATA_SIZE (4 * 1024 * 1024)                             // bytes per benchmark run
+#define RUNS 10
+
+
+
+template<typename F>
+double measure(F && f) {
+ // run f RUNS times, return best time in seconds
+ double best{1e100};
+ for(int i = 0; i < RUNS; ++i) {
+  auto start = chrono::steady_clock::now();
+  f();
+  chrono::duration<double> d = chrono::steady_clock::now() - start;
+  best = min(best, d.count());
+ }
+ return best;
+}
+
+
+void report(const char *name, double append_sec, double restore_sec, size_t bytes) {
+ double mb = bytes / (1024. * 1024.);
+ cout << left << setw(34) << name << right << fixed << setprecision(1)
+      << "append: " << setw(8) << mb / append_sec << " MB/s,  "
+      << "restore: " << setw(8) << mb / restore_sec << " MB/s" << endl;
+}
+
+
+
+int main(void) {
+ vector<int> vi(DATA_SIZE / sizeof(int));
+ for(size_t i = 0; i < vi.size(); ++i) vi[i] = i;
+ vector<double> vd(DATA_SIZE / sizeof(double), 3.14);
+ string str(DATA_SIZE, 'x');
+ static int ai[DATA_SIZE / sizeof(int)];
+ Blob b;
+
+ // bulk paths
+ double as = measure([&]{ b.clear().append(vi); });
+ double rs = measure([&]{ vector<int> v; b.reset().restore(v); });
+ report("vector<int> (bulk)", as, rs, DATA_SIZE);
+
+ as = measure([&]{ b.clear().append(vd); });
+ rs = measure([&]{ vector<double> v; b.reset().restore(v); });
+ report("vector<double> (bulk)", as, rs, DATA_SIZE);
+
+ as = measure([&]{ b.clear().append(str); });
+ rs = measure([&]{ string s; b.reset().restore(s); });
+ report("string (bulk)", as, rs, DATA_SIZE);
+
+ as = measure([&]{ b.clear().append(ai); });
+ rs = measure([&]{ b.reset().restore(ai); });
+ report("int[] (bulk)", as, rs, DATA_SIZE);
+
+ // element-wise reference: same data, appended/restored one value at a time
+ as = measure([&]{ b.clear(); for(auto v: vi) b.append(v); });
+ rs = measure([&]{ b.reset(); for(auto &v: vi) b.restore(v); });
+ report("int (element-wise reference)", as, rs, DATA_SIZE);
+
+ as = measure([&]{ b.clear(); for(auto c: str) b.append(c); });
+ rs = measure([&]{ b.reset(); for(auto &c: str) b.restore(c); });
+ report("char (element-wise reference)", as, rs, DATA_SIZE);
+
+ return 0;
+}
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include "lib/Json.hpp"
+
+using namespace std;
+
+/*
+c++ -o bmj -Wall -std=gnu++14 -O3 bm_json.cpp
+
+benchmark of decoding the same document from JSON text (Json::parse) vs from CBOR and
+MessagePack (Jbin readers, jsl's option -f); binary encodings of the document are
+produced by trivial encoders below (sufficient for the generated document: no escaped
+characters in strings)
+
+usage: bmj [records]
+*/
+
+#define RECORDS 100000                                          // records in the document
+#define RUNS 5
+
+
+
+size_t records{RECORDS};
+
+
+
+// encoders: header of given major type (CBOR) / type family (MessagePack) with a size
+string cbor_head(uint8_t major, uint64_t n) {
+ string s;
+ if(n < 24) return s += char(major << 5 | n);
+ int bytes = n <= 0xFF? 1: n <= 0xFFFF? 2: n <= 0xFFFFFFFF? 4: 8;
+ s += char(major << 5 | (bytes == 1? 24: bytes == 2? 25: bytes == 4? 26: 27));
+ while(bytes--) s += char(n >> (bytes * 8));
+ return s;
+}
+
+
+string cbor(const Jnode &jn) {
+ string s;
+ switch(jn.type()) {
+  case Jnode::Object:
+        s = cbor_head(5, jn.children());
+        for(auto &rec: jn)
+         s += cbor_head(3, rec.label().size()) + rec.label() + cbor(rec);
+        return s;
+  case Jnode::Array:
+        s = cbor_head(4, jn.children());
+        for(auto &rec: jn) s += cbor(rec);
+        return s;
+  case Jnode::String: return cbor_head(3, jn.str().size()) + jn.str();
+  case Jnode::Number: {
+        if(jn.val().find_first_of(".eE") == string::npos) {
+         long long x = stoll(jn.val());
+         return x >= 0? cbor_head(0, x): cbor_head(1, -1 - x);
+        }
+        double d = jn.num();
+        uint64_t x;
+        memcpy(&x, &d, sizeof(x));
+        s = '\xFB';
+        for(int i = 7; i >= 0; --i) s += char(x >> (i * 8));
+        return s;
+       }
+  case Jnode::Bool: return jn.bul()? "\xF5": "\xF4";
+  default: return "\xF6";
+ }
+}
+
+
+string mp_head(uint8_t fix, uint8_t fix_max, uint8_t c16, uint64_t n) {
+ // fix-type if fits, otherwise 16/32 bit sized type
+ string s;
+ if(n <= fix_max) return s += char(fix | n);
+ int bytes = n <= 0xFFFF? 2: 4;
+ s += char(bytes == 2? c16: c16 + 1);
+ while(bytes--) s += char(n >> (bytes * 8));
+ return s;
+}
+
+
+string msgpack(const Jnode &jn) {
+ string s;
+ switch(jn.type()) {
+  case Jnode::Object:
+        s = mp_head(0x80, 15, 0xDE, jn.children());
+        for(auto &rec: jn)
+         s += mp_head(0xA0, 31, 0xDA, rec.label().size()) + rec.label() + msgpack(rec);
+        return s;
+  case Jnode::Array:
+        s = mp_head(0x90, 15, 0xDC, jn.children());
+        for(auto &rec: jn) s += msgpack(rec);
+        return s;
+  case Jnode::String: return mp_head(0xA0, 31, 0xDA, jn.str().size()) + jn.str();
+  case Jnode::Number: {
+        bool integer = jn.val().find_first_of(".eE") == string::npos;
+        long long i = integer? stoll(jn.val()): 0;
+        if(integer and i >= 0 and i < 128) return s += char(i);
+        double d = jn.num();
+        uint64_t x;
+        memcpy(&x, &d, sizeof(x));
+        if(integer) memcpy(&x, &i, sizeof(x));
+        s = integer? '\xD3': '\xCB';                            // int64 or float64
+        for(int b = 7; b >= 0; --b) s += char(x >> (b * 8));
+        return s;
+       }
+  case Jnode::Bool: return jn.bul()? "\xC3": "\xC2";
+  default: return "\xC0";
+ }
+}
+
+
+
+template<typename F>
+double measure(F && f) {
+ // run f RUNS times, return best time in seconds
+ double best{1e100};
+ for(int i = 0; i < RUNS; ++i) {
+  auto start = chrono::steady_clock::now();
+  f();
+  chrono::duration<double> d = chrono::steady_clock::now() - start;
+  best = min(best, d.count());
+ }
+ return best;
+}
+
+
+void report(const string &name, size_t bytes, double sec) {
+ cout << left << setw(14) << name << right << fixed << setprecision(1)
+      << setw(10) << bytes / 1048576. << " MB" << setw(10) << bytes / 1048576. / sec << " MB/s"
+      << setw(12) << records / sec << " records/s" << endl;
+}
+
+
+
+int main(int argc, char *argv[]) {
+ if(argc > 1) records = stoul(argv[1]);
+ Json json{ARY{}};
+ for(size_t i = 0; i < records; ++i)
+  json.push_back(OBJ{ LBL{"id", NUM{double(i)}},
+                      LBL{"name", STR{"name_" + to_string(i)}},
+                      LBL{"active", BUL{i % 2 == 0}},
+                      LBL{"score", NUM{i * 0.25}},
+                      LBL{"address", OBJ{ LBL{"street", STR{"599 Lafayette St"}},
+                                          LBL{"city", STR{"New York"}},
+                                          LBL{"zip", NUM{10012}} }},
+                      LBL{"tags", ARY{ STR{"a"}, STR{"b"}, NUL{} }} });
+ stringstream ss;
+ ss << json.raw();
+ string text = ss.str(), cb = cbor(json.root()), mp = msgpack(json.root());
+
+ double sec = measure([&] { Json j; j.parse(text); });
+ report("JSON text", text.size(), sec);
+ sec = measure([&] { Json j{Jbin::from_cbor(cb)}; });
+ report("CBOR", cb.size(), sec);
+ sec = measure([&] { Json j{Jbin::from_msgpack(mp)}; });
+ report("MessagePack", mp.size(), sec);
+
+ if(Json{Jbin::from_cbor(cb)} != json or Json{Jbin::from_msgpack(mp)} != json)
+  { cerr << "error: decoded documents differ from the source" << endl; return 1; }
+ return 0;
+}
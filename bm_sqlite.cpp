@@ -0,0 +1,97 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include "lib/Sqlite.hpp"
+
+using namespace std;
+
+/*
+c++ -o bm -Wall -std=gnu++14 -O3 bm_sqlite.cpp -lsqlite3
+
+benchmark of bulk inserts: rows inserted by a prepared statement (binding each value,
+as jsl does w/o batching) vs rows inserted in batches from a row source (eponymous
+virtual table, jsl's option -b)
+
+usage: bm [-c] [db_file]
+ -c: run with sqlite tuned for bulk loads (slab page cache, jsl's option -c)
+ db_file: benchmark over a db file instead of in-memory db
+*/
+
+#define ROWS 200000                                             // rows per benchmark run
+#define COLUMNS 5
+#define RUNS 5
+
+
+
+string db_file{":memory:"};
+
+
+
+template<typename F>
+double measure(F && f) {
+ // run f RUNS times (each over a fresh db), return best time in seconds
+ double best{1e100};
+ for(int i = 0; i < RUNS; ++i) {
+  remove(db_file.c_str());
+  Sqlite db(db_file);
+  db.compile("CREATE TABLE t (c0 TEXT PRIMARY KEY, c1 TEXT, c2 TEXT, c3 NUMERIC, c4 NUMERIC);");
+  auto start = chrono::steady_clock::now();
+  f(db);
+  db.close();
+  chrono::duration<double> d = chrono::steady_clock::now() - start;
+  best = min(best, d.count());
+ }
+ remove(db_file.c_str());
+ return best;
+}
+
+
+void report(const string &name, double sec) {
+ cout << left << setw(34) << name << right << fixed << setprecision(1)
+      << setw(12) << ROWS / sec << " rows/s" << endl;
+}
+
+
+
+int main(int argc, char *argv[]) {
+ for(int i = 1; i < argc; ++i)
+  if(string(argv[i]) == "-c") {
+   if(Sqlite::tune_for_bulk_load() != SQLITE_OK)
+    { cerr << "failed tuning sqlite" << endl; return 1; }
+  }
+  else db_file = argv[i];
+ Sqlite::v_rows rows;
+ for(size_t i = 0; i < ROWS; ++i)
+  rows.push_back({"name_" + to_string(i), "city", "some street address " + to_string(i),
+                  to_string(i % 100), to_string(i * 7)});
+
+ // prepared statement: bind each value, step each row
+ double sec = measure([&](Sqlite &db) {
+  db.begin_transaction().compile("INSERT INTO t VALUES (?,?,?,?,?);");
+  for(auto &row: rows) db << row;
+ });
+ report("prepared statement (per row)", sec);
+
+ // row source: a single step per batch
+ for(size_t batch: {100, 1000, 10000, ROWS}) {
+  vector<Sqlite::v_rows> batches;                               // prepare batches upfront
+  for(size_t i = 0; i < rows.size(); i += batch)
+   batches.emplace_back(rows.begin() + i, rows.begin() + min(i + batch, rows.size()));
+
+  Sqlite::RowSource rs{COLUMNS};
+  sec = measure([&](Sqlite &db) {
+   db.row_source("rows", rs)
+     .begin_transaction().compile("INSERT INTO t SELECT * FROM rows;");
+   for(auto &b: batches) {
+    rs.rows.swap(b);                                            // lend batch to row source
+    db.execute();
+    rs.rows.swap(b);
+   }
+  });
+  report("row source (batch " + to_string(batch) + ")", sec);
+ }
+
+ return 0;
+}
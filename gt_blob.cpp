@@ -1,9 +1,11 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <list>
 #include <deque>
 #include <map>
+#include <cstdint>
 #include <string>
 #include <string.h>
 #include <gtest/gtest.h>
@@ -316,6 +318,179 @@ TEST(SERDES_test, resource_handler_pointer) {
 
 
 
+class BulkData {
+    // contiguous data which is SERDES'ed in bulk (memcpy), rather than element-wise
+    static constexpr int size = 4;
+    int                 m_[size][size]{ {1, 2, 3, 4}, {5, 6, 7, 8},
+                                        {9, 10, 11, 12}, {13, 14, 15, 16} };
+    vector<double>      vd_;
+    vector<uint8_t>     vb_;
+    string              s_{string("embedded\0zero", 13)};
+
+ public:
+                        BulkData(Init x = Preserve) {
+                         for(int i = 0; i < 100000; ++i) vd_.push_back(i * 1.5);
+                         vb_.assign(vd_.size(), 0xA5);
+                         if(x == Clear) nullify();
+                        }
+
+    void                nullify(void)
+                         { memset(m_, 0, sizeof(m_)); vd_.clear(); vb_.clear(); s_.clear(); }
+
+    bool                operator==(const BulkData & r) const {
+                         return memcmp(m_, r.m_, sizeof(m_)) == 0 and
+                                vd_ == r.vd_ and vb_ == r.vb_ and s_ == r.s_;
+                        }
+
+    SERDES(BulkData, m_, vd_, vb_, s_)
+};
+
+TEST(SERDES_test, bulk_contiguous_data) {
+ BulkData src, dst(Clear);
+ Blob b(src);
+ b.restore(dst);
+ EXPECT_EQ(dst, src);
+ EXPECT_EQ(b.offset(), b.size());
+}
+
+TEST(SERDES_test, restore_beyond_blob_end) {
+ vector<int> src{1, 2, 3}, dst;
+ Blob b(src);
+ b.store().pop_back();                      // truncate the blob
+ EXPECT_THROW(b.restore(dst), Blob::stdException);
+
+ string s;
+ b.clear().append(string("abc"));
+ b.store().pop_back();
+ EXPECT_THROW(b.restore(s), Blob::stdException);
+
+ b.clear().encoding(Blob::compact).append(uint64_t(1ull << 40));  // bogus string length
+ EXPECT_THROW(b.restore(s), Blob::stdException);
+ EXPECT_TRUE(s.empty());                                        // nothing was allocated
+}
+
+
+
+class SmallInts {
+    // for compact encoding tests: mostly small (and negative) integral values
+    enum Lvl: uint16_t { Low, Mid, High };
+    short               s_{-3};
+    int64_t             l_{-9876543210};
+    uint32_t            u_{0xFFFFFFFF};
+    Lvl                 e_{High};
+    int                 a_[2][3]{ {-1, 0, 1}, {200, -200, 1 << 30} };
+    vector<int>         vs_;                                    // sorted
+    vector<int>         vu_{5, -7, 3, 0};                       // unsorted
+    list<uint64_t>      ls_{1, 2, 3, 1000, 1ul << 60};          // sorted
+    map<int, string>    m_{ {-1, "minus one"}, {1, "one"} };
+    double              d_{3.14};
+
+ public:
+                        SmallInts(Init x = Preserve) {
+                         for(int i = -500; i < 500; ++i) vs_.push_back(i * 3);
+                         if(x == Clear) nullify();
+                        }
+
+    void                nullify(void) {
+                         s_= l_= u_= 0; e_= Low; d_= 0;
+                         memset(a_, 0, sizeof(a_));
+                         vs_.clear(); vu_.clear(); ls_.clear(); m_.clear();
+                        }
+
+    bool                operator==(const SmallInts & r) const {
+                         return s_== r.s_ and l_== r.l_ and u_== r.u_ and e_== r.e_ and
+                                memcmp(a_, r.a_, sizeof(a_)) == 0 and vs_== r.vs_ and
+                                vu_== r.vu_ and ls_== r.ls_ and m_== r.m_ and d_== r.d_;
+                        }
+
+    SERDES(SmallInts, s_, l_, u_, e_, a_, vs_, vu_, ls_, m_, d_)
+};
+
+TEST(SERDES_test, compact_encoding) {
+ SmallInts src;
+ Blob n(src);
+ size_t native_size = n.size();
+
+ for(auto enc: {Blob::compact, Blob::delta}) {
+  SmallInts dst(Clear);
+  Blob b;
+  b.encoding(enc).append(src);
+  EXPECT_LT(b.size(), native_size);
+  b.restore(dst);
+  EXPECT_EQ(dst, src);
+  EXPECT_EQ(b.offset(), b.size());
+  if(enc == Blob::compact) native_size = b.size();              // delta must beat compact
+ }
+}
+
+TEST(SERDES_test, compact_encoding_of_bad_data) {
+ Blob b;
+ b.encoding(Blob::compact).append(uint32_t(0xFFFFFFFF));
+ b.store().pop_back();                                          // truncate varint
+ uint32_t u;
+ EXPECT_THROW(b.restore(u), Blob::stdException);
+
+ int64_t l{1ll << 40};                                          // does not fit int restore
+ int i;
+ b.clear().append(l);
+ EXPECT_THROW(b.restore(i), Blob::stdException);
+
+ uint64_t x;                                                    // max value fits 10 bytes
+ b.clear().append(uint64_t(UINT64_MAX));
+ EXPECT_EQ(b.size(), 10u);
+ EXPECT_EQ(b.restore(x), UINT64_MAX);
+ b.store().back() = 0x02;                                       // 10th byte overflows 64 bits
+ EXPECT_THROW(b.reset().restore(x), Blob::stdException);
+}
+
+
+
+TEST(SERDES_test, streaming_sink_and_source) {
+ BulkData src1, src2(Clear);
+ SmallInts src3;
+ Blob b(src1);                                                  // reference image
+ b.append(src2, src3);
+
+ { BlobSink bs(FILE, 100);                                      // tiny buffer: spill often
+   bs.append(src1, src2, src3);
+   EXPECT_EQ(bs.flushed() + bs.size(), b.size());
+   const Blob & as_blob = bs;                                   // size() matches data()
+   EXPECT_LT(as_blob.size(), 100u);
+   EXPECT_EQ(memcmp(as_blob.data(), b.data() + bs.flushed(), as_blob.size()), 0);
+   std::stringstream ss;                                        // Blob level output: buffer
+   ss << as_blob;
+   EXPECT_EQ(ss.str().size(), as_blob.size()); }
+
+ BlobView bv(FILE);                                             // same image as Blob's
+ ASSERT_EQ(bv.size(), b.size());
+ EXPECT_EQ(memcmp(bv.data(), b.data(), b.size()), 0);
+
+ BlobSource bsrc(FILE, 37);
+ BulkData dst1(bsrc), dst2(bsrc);
+ SmallInts dst3(bsrc);
+ EXPECT_EQ(dst1, src1);
+ EXPECT_EQ(dst2, src2);
+ EXPECT_EQ(dst3, src3);
+ EXPECT_EQ(bsrc.offset(), b.size());
+ EXPECT_TRUE(bsrc.eof());
+ EXPECT_THROW(bsrc.restore(dst3), Blob::stdException);
+ remove(FILE);
+}
+
+TEST(SERDES_test, streaming_compact_encoding) {
+ SmallInts src, dst(Clear);
+ { BlobSink bs(FILE, 16);
+   bs.encoding(Blob::delta).append(src); }
+
+ BlobSource bsrc(FILE, 16);
+ bsrc.encoding(Blob::delta).restore(dst);
+ EXPECT_EQ(dst, src);
+ EXPECT_TRUE(bsrc.eof());
+ remove(FILE);
+}
+
+
+
 class DataTree {
  public:
     int                 x{0};
@@ -329,6 +504,63 @@ class DataTree {
     SERDES(DataTree, x, v)
 };
 
+TEST(SERDES_test, blob_view_of_memory) {
+ BulkData src;
+ Blob b(src);
+
+ BlobView bv(b.data(), b.size());                               // no copy of b's data
+ BulkData dst(bv);
+ EXPECT_EQ(dst, src);
+ EXPECT_EQ(bv.offset(), bv.size());
+ EXPECT_THROW(bv.restore(dst), Blob::stdException);             // nothing left to restore
+}
+
+
+
+TEST(SERDES_test, blob_view_as_blob) {
+ BulkData src;
+ Blob b(src);
+ unique_ptr<BlobView> bv(new BlobView(b.data(), b.size()));
+ const Blob & cb = *bv;
+ EXPECT_EQ(cb.size(), b.size());                                // accessors see viewed data
+ EXPECT_EQ(cb.data(), b.data());
+ EXPECT_FALSE(cb.empty());
+
+ Blob & ab = *bv;
+ EXPECT_THROW(ab.append(src), Blob::stdException);              // view is restore-only
+
+ Blob copy(cb);                                                 // a copy holds the data
+ bv.reset();
+ EXPECT_EQ(copy.size(), b.size());
+ copy.append(src);                                              // and is appendable
+ BulkData dst1(copy), dst2(copy);
+ EXPECT_EQ(dst1, src);
+ EXPECT_EQ(dst2, src);
+}
+
+
+
+TEST(SERDES_test, blob_view_of_mapped_file) {
+ BulkData src1, src2(Clear);
+ Blob b(src1);
+ b.append(src2);
+ { ofstream bf(FILE, ios::binary); bf << b; }
+
+ BlobView bv(FILE);
+ EXPECT_TRUE(bv.is_mapped());
+ BulkData dst1(bv), dst2(bv);
+ EXPECT_EQ(dst1, src1);
+ EXPECT_EQ(dst2, src2);
+
+ BlobView mv(move(bv));                                         // mapping is moved along
+ EXPECT_TRUE(mv.is_mapped());
+ EXPECT_FALSE(bv.is_mapped());
+ remove(FILE);
+ EXPECT_THROW(BlobView{FILE}, Blob::stdException);
+}
+
+
+
 TEST(SERDES_test, data_tree) {
  DataTree src, dst;
 
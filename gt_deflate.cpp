@@ -0,0 +1,42 @@
+#include <iostream>
+#include <string>
+#include <gtest/gtest.h>
+#include "lib/Deflate.hpp"
+
+using namespace std;
+
+/*
+c++ -o ud -Wall -std=gnu++14 gt_deflate.cpp -lgtest -lsqlite3 -lz
+*/
+
+#define TEXT "{ \"name\": \"Doc Brown\", \"city\": \"Hill Valley\", \"year\": 1985 }"
+
+
+
+TEST(DEFLATE_test, round_trip) {
+ Deflate z;
+ string blob = z.compress(TEXT);
+ EXPECT_EQ(Deflate::decompress(blob), TEXT);
+ EXPECT_EQ(Deflate::decompress(z.compress("")), "");
+}
+
+
+
+TEST(DEFLATE_test, empty_and_truncated_streams) {
+ EXPECT_THROW(Deflate::decompress(""), Deflate::stdException);
+
+ Deflate z;
+ string blob = z.compress(string(1000, 'x') + TEXT);           // output outgrows 4x input
+ for(size_t size: {size_t{1}, blob.size() / 2, blob.size() - 1})
+  EXPECT_THROW(Deflate::decompress(blob.substr(0, size)), Deflate::stdException);
+}
+
+
+
+
+
+int main( int argc, char *argv[]) {
+
+ testing::InitGoogleTest(&argc, argv);
+ return RUN_ALL_TESTS();
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <iterator>
+#include <future>
+#include <gtest/gtest.h>
+
+#define main jsl_main                                           // exercise jsl end to end
+#include "jsl.cpp"
+#undef main
+
+using namespace std;
+
+/*
+c++ -o ul -Wall -std=gnu++14 gt_jsl.cpp -lgtest -lsqlite3 -lpthread -lz
+*/
+
+#define DB "gt_jsl.db"
+#define TARGET "gt_jsl_target.db"
+
+
+
+int run_jsl(vector<string> args, const string &input, chrono::seconds timeout, bool &done) {
+ // run jsl over the input in own thread, give up waiting after timeout
+ args.insert(args.begin(), "jsl");
+ auto in = make_shared<stringstream>(input), out = make_shared<stringstream>();
+ auto rc = make_shared<promise<int>>();
+ auto finished = rc->get_future();
+ auto cin_buf = cin.rdbuf(in->rdbuf());
+ auto cout_buf = cout.rdbuf(out->rdbuf());
+ thread([args, in, out, rc]() mutable {
+         vector<char *> argv;
+         for(auto &arg: args) argv.push_back(&arg[0]);
+         rc->set_value(jsl_main(argv.size(), argv.data()));
+        }).detach();                                            // a blocked jsl is left behind
+ done = finished.wait_for(timeout) == future_status::ready;
+ if(not done) return -1;
+ cin.rdbuf(cin_buf);
+ cout.rdbuf(cout_buf);
+ return finished.get();
+}
+
+
+
+TEST(JSL_test, failing_target_does_not_block_producer) {
+ remove(DB);
+ remove(TARGET);
+ Sqlite target(TARGET);
+ target.compile("CREATE TABLE AB (Name TEXT PRIMARY KEY, city TEXT);");
+ target.compile("BEGIN IMMEDIATE;");                            // target is locked for writes
+
+ string input = R"({ "AddressBook": [)";
+ for(int i = 0; i < 50; ++i)
+  input += string(i == 0? "": ",") + R"({ "Name": "n)" + to_string(i) + R"(", "city": "c" })";
+ input += "] }";
+
+ bool done;
+ int rc = run_jsl({"-a", "-m", "Name", "-m", "city", "-o", TARGET, "-B", "2", DB, "AB"},
+                  input, chrono::seconds(20), done);
+ ASSERT_TRUE(done) << "jsl got blocked by a failed target";
+ EXPECT_EQ(rc, Sqlite::could_not_evaluate_sql_statement + OFF_JSL);    // target's error relayed
+
+ target.compile("ROLLBACK;");
+ target.close();
+ remove(DB);
+ remove(TARGET);
+}
+
+
+
+
+
+int main( int argc, char *argv[]) {
+
+ testing::InitGoogleTest(&argc, argv);
+ return RUN_ALL_TESTS();
+}
@@ -0,0 +1,411 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <gtest/gtest.h>
+#include "lib/Json.hpp"
+
+using namespace std;
+
+/*
+c++ -o uj -Wall -std=gnu++14 gt_json.cpp -lgtest
+*/
+
+#define DOC R"({ "a": { "b": [ 1, 2, { "c": "x" } ], "d": true }, "e": null })"
+
+
+
+TEST(JSON_test, hash_follows_edits_via_retained_reference) {
+ Json json = DOC ""_json;
+ auto h0 = json.hash(), s0 = json.size();
+ Jnode & c = json["a"]["b"][2];                                 // retained reference
+ EXPECT_EQ(json.hash(), h0);                                    // non-modifying access
+ c["c"] = "y";
+ EXPECT_NE(json.hash(), h0);
+ EXPECT_EQ(json.hash(), json.hash(false));
+ c["f"] = 3.;                                                   // new label
+ EXPECT_EQ(json.size(), s0 + 1);
+ EXPECT_EQ(json.hash(), json.hash(false));
+ c["c"] = "x";
+ c.erase("f");
+ EXPECT_EQ(json.hash(), h0);
+ EXPECT_EQ(json.size(), s0);
+
+ Json copy = json;                                              // caches of own ancestors
+ Jnode & d = copy["a"]["d"];                                    // are voided
+ EXPECT_EQ(copy.hash(), h0);
+ d = false;
+ EXPECT_EQ(copy.hash(), copy.hash(false));
+ EXPECT_NE(copy.hash(), h0);
+ EXPECT_EQ(json.hash(), h0);
+}
+
+
+
+TEST(JSON_test, hash_follows_edits_via_walk_iterators) {
+ Json json = DOC ""_json;
+ auto h0 = json.hash(), s0 = json.size();
+ for(auto & jn: json.walk("<c>l"))
+  jn = ARY{ 1, 2 };
+ EXPECT_NE(json.hash(), h0);
+ EXPECT_EQ(json.hash(), json.hash(false));
+ EXPECT_EQ(json.size(), s0 + 2);
+
+ auto it = json.walk("[a][b]");
+ it->push_back(3.);
+ EXPECT_EQ(json.hash(), json.hash(false));
+ EXPECT_EQ(json.size(), s0 + 3);
+ EXPECT_EQ(json["a"]["b"].children(), 4u);
+}
+
+
+
+
+TEST(JSON_test, caches_follow_patches) {
+ Json json = DOC ""_json;
+ EXPECT_EQ(json.size(), 9u);                                    // caches are taken
+ json.hash();
+ json.patch(R"([ { "op": "remove", "path": "/a/b" },
+                 { "op": "move", "from": "/a/d", "path": "/f" } ])"_json);
+ Json fresh = R"({ "a": {}, "e": null, "f": true })"_json;
+ EXPECT_EQ(json, fresh);
+ EXPECT_EQ(json.size(), fresh.size());
+ EXPECT_EQ(json.hash(), fresh.hash());
+}
+
+
+
+
+TEST(JSON_test, size_ignores_duplicate_labels) {
+ Json json = R"({ "a": 1, "b": [ 1, 2 ], "a": [ 1, 2, 3 ] })"_json;
+ EXPECT_EQ(json["a"].num(), 1);                                 // first label wins
+ EXPECT_EQ(json.size(), 5u);
+
+ Json cbor{Jbin::from_cbor("\xA2\x61" "a" "\x01\x61" "a" "\x82\x01\x02")};  // same in CBOR
+ EXPECT_EQ(cbor.size(), 2u);
+}
+
+
+
+
+size_t recount(const Jnode & jn) {
+ // count nodes of the tree by walking it (bypassing cached sizes)
+ size_t size = 1;
+ if(jn.is_iterable())
+  for(auto & child: jn)
+   size += recount(child);
+ return size;
+}
+
+
+TEST(JSON_test, sizes_follow_edits) {
+ Json json = DOC ""_json;
+ json["a"]["b"].push_back(ARY{ 3, 4 });
+ EXPECT_EQ(json.size(), recount(json.root()));
+ json["a"]["b"][2] = OBJ{ LBL{ "c", ARY{ 5 } } };
+ EXPECT_EQ(json.size(), recount(json.root()));
+ json["a"]["b"].erase(1);
+ EXPECT_EQ(json.size(), recount(json.root()));
+ json["a"] = json["a"]["b"];                                    // own subtree
+ EXPECT_EQ(json.size(), recount(json.root()));
+ swap(json["a"][1], json["e"]);
+ EXPECT_EQ(json["a"].size(), recount(json["a"]));
+ EXPECT_EQ(json.size(), recount(json.root()));
+ json["a"].pop_back();
+ EXPECT_EQ(json.size(), recount(json.root()));
+ json["a"].clear();
+ EXPECT_EQ(json.size(), recount(json.root()));
+ EXPECT_EQ(json.size(), 5u);
+}
+
+
+
+TEST(JSON_test, copies_are_independent_values) {
+ Json json = DOC ""_json, copy = json, shared = json.share();
+ const Json & cjson = json, & ccopy = copy;
+ for(const auto & jn: json.walk("<c>l"))                        // read-only walk
+  EXPECT_EQ(jn.str(), "x");
+ EXPECT_EQ(&cjson["a"]["b"][2], &ccopy["a"]["b"][2]);           // copies share nodes
+ for(auto & jn: json.walk("<c>l"))                              // copy then walk-edit
+  jn = "y";
+ EXPECT_EQ(json["a"]["b"][2]["c"].str(), "y");
+ EXPECT_EQ(copy["a"]["b"][2]["c"].str(), "x");
+ EXPECT_EQ(shared["a"]["b"][2]["c"].str(), "x");
+ EXPECT_NE(json, copy);
+ EXPECT_EQ(copy, shared);
+
+ auto it = json.walk("[a][b][+0]");                             // walk, then copy
+ copy = json;
+ json["a"]["b"].push_back(3.);                                  // must not detach walked nodes
+ EXPECT_EQ(copy["a"]["b"].children(), 3u);
+ *it = 0.;
+ EXPECT_EQ(json["a"]["b"][0].num(), 0);
+ EXPECT_EQ(copy["a"]["b"][0].num(), 1);
+
+ copy = json;                                                   // walk into shared nodes
+ auto jt = json.walk("[a][d]");
+ *jt = false;                                                   // detaches the walked path
+ EXPECT_FALSE(json["a"]["d"].bul());
+ EXPECT_TRUE(copy["a"]["d"].bul());
+}
+
+
+
+TEST(JSON_test, walk_iterators_survive_detaching) {
+ Json json = DOC ""_json;
+ Json shared = json.share();
+ auto it = json.walk("[a][b][+0]");                             // iterate then subscript
+ json["e"] = true;
+ json["a"]["b"][1] = 20.;
+ std::vector<double> nums;
+ for(; it != it.end(); ++it)
+  if(it->is_number()) { nums.push_back(it->num()); *it = -it->num(); }
+ EXPECT_EQ(nums, (std::vector<double>{1, 20}));
+ EXPECT_EQ(json["a"]["b"][0].num(), -1);
+ EXPECT_EQ(json["a"]["b"][1].num(), -20);
+ EXPECT_EQ(shared, DOC ""_json);                                // the sharer is intact
+
+ auto end = json.walk("[a][b][7]");                             // end sentinel remains valid
+ json.erase("e");
+ EXPECT_TRUE(end == end.end());
+
+ Json big = DOC ""_json;                                        // detach is one level deep
+ shared = big.share();
+ const Json & cbig = big, & cshared = shared;
+ big["e"] = false;
+ EXPECT_EQ(&cbig["a"]["b"].front(), &cshared["a"]["b"].front());
+ big["a"]["d"] = false;
+ EXPECT_EQ(&cbig["a"]["b"].front(), &cshared["a"]["b"].front());
+ EXPECT_NE(&cbig["a"]["d"], &cshared["a"]["d"]);
+ EXPECT_EQ(shared, DOC ""_json);
+}
+
+
+
+
+TEST(JSON_test, search_cache_follows_edits_via_iterators) {
+ Json json = DOC ""_json;
+ Jnode & b = json["a"]["b"];                                    // retained before searches
+ auto found = [&json](Json::CacheState cs) {                    // numbers found under "c"
+               std::vector<double> nums;
+               for(auto & jn: json.walk("<c>l+0", cs))
+                nums.push_back(jn.is_number()? jn.num(): 0);
+               return nums;
+              };
+ EXPECT_EQ(found(Json::invalidate), (std::vector<double>{0}));  // search is cached at root
+
+ json.walk("[a][b]", Json::keep_cache)->push_back(OBJ{ LBL{ "c", 1 } });
+ *json.walk("[a][d]", Json::keep_cache) = OBJ{ LBL{ "c", 2 } };
+ EXPECT_EQ(found(Json::keep_cache), (std::vector<double>{0, 1, 2}));
+
+ for(auto it = b.begin(); it != b.end(); ++it)                  // edits deep below root
+  if(it->is_object()) (*it)["c"] = 3.;
+ EXPECT_EQ(found(Json::keep_cache), (std::vector<double>{3, 3, 2}));
+
+ b.erase(b.begin());                                            // erase via iterator, index
+ b.erase(2);
+ EXPECT_EQ(found(Json::keep_cache), (std::vector<double>{3, 2}));
+ EXPECT_EQ(found(Json::keep_cache), found(Json::invalidate));
+}
+
+
+
+TEST(JSON_test, interned_subtrees_survive_walks) {
+ Json json;
+ json.intern_subtrees().parse(R"([ { "a": [ 1, 2 ] }, { "a": [ 1, 2 ] } ])");
+ const Json & cjson = json;
+ EXPECT_EQ(&cjson[0]["a"][0], &cjson[1]["a"][0]);               // stored once
+ size_t n = 0;
+ for(const auto & jn: json.walk("<a>l+0"))                      // read-only walk
+  n += jn.children();
+ EXPECT_EQ(n, 4u);
+ EXPECT_EQ(&cjson[0]["a"][0], &cjson[1]["a"][0]);               // still shared
+
+ for(auto & jn: json.walk("[0]<a>l"))                           // modification detaches
+  jn.push_back(3.);
+ EXPECT_EQ(json[0]["a"].children(), 3u);
+ EXPECT_EQ(json[1]["a"].children(), 2u);
+}
+
+
+
+
+TEST(JSON_test, label_callbacks_in_own_scopes) {
+ Json json = R"({ "shipping": { "city": "A" },
+                   "billing": { "city": "B", "x": { "city": "C" } } })"_json;
+ std::vector<std::string> shipping, billing, any;
+ json.callback("city", 0, "shipping", [&](const Jnode &jn) { shipping.push_back(jn.str()); })
+     .callback("city", 0, "billing", [&](const Jnode &jn) { billing.push_back(jn.str()); })
+     .callback("city", 2, "", [&](const Jnode &jn) { any.push_back(jn.str()); })
+     .engage_callbacks().walk("<.^>R", Json::keep_cache);
+ EXPECT_EQ(shipping, (std::vector<std::string>{"A"}));
+ EXPECT_EQ(billing, (std::vector<std::string>{"B"}));
+ EXPECT_EQ(any, (std::vector<std::string>{"B", "A"}));          // labels are walked sorted
+}
+
+
+
+
+TEST(JSON_test, binary_input_honors_limits) {
+ std::string deep(100, '\x81'), tags(100, '\xC0');              // nested arrays, nested tags
+ deep += '\x01';
+ tags += '\x01';
+ Json::Limits lim;
+ lim.depth = 64;
+ EXPECT_EQ(Jbin::from_cbor(deep).children(), 1u);               // no limits by default
+ EXPECT_THROW(Jbin::from_cbor(deep, lim), Jbin::stdException);
+ EXPECT_THROW(Jbin::from_cbor(tags, lim), Jbin::stdException);
+ lim.depth = 100;
+ EXPECT_EQ(Jbin::from_cbor(deep, lim).children(), 1u);
+
+ lim.nodes = 3;                                                 // msgpack {"a": [1]}: 4 nodes
+ EXPECT_THROW(Jbin::from_msgpack("\x81\xA1" "a" "\x91\x01", lim), Jbin::stdException);
+ lim.nodes = 4;
+ EXPECT_EQ(Jbin::from_msgpack("\x81\xA1" "a" "\x91\x01", lim).size(), 3u);
+ EXPECT_EQ(Jbin::detect("\x81\xA2" "ab" "\x01"), Jbin::msgpack); // {"ab": 1}
+
+ std::string pack(200000, '\x91'), tag(200000, '\xC1');         // deep msgpack: probing it as
+ pack += '\x01';                                                // CBOR must not recurse deeply
+ tag += '\x01';
+ lim = Json::Limits{};
+ lim.depth = 64;
+ auto format = Jbin::detect(pack, lim);
+ EXPECT_THROW(format == Jbin::cbor? Jbin::from_cbor(pack, lim): Jbin::from_msgpack(pack, lim),
+              Jbin::stdException);
+ Jbin::detect(pack);                                            // own budget bounds the probe
+ Jbin::detect(tag);
+}
+
+
+
+
+TEST(JSON_test, bounded_regex_keeps_ranges) {
+ auto labels = [](Json &json) {
+  std::vector<std::string> found;
+  for(auto it = json.walk("<^[a-z]+$>L+0"); it != it.end(); ++it)
+   found.push_back(it->label());
+  return found;
+ };
+ std::string doc = R"({ "ab": 1, "aB": 2, ")" "\xC3\xA9" R"(": 3, "Z": 4, "z": 5 })";
+ Json json(doc);
+ auto unbounded = labels(json);
+ EXPECT_EQ(unbounded, (std::vector<std::string>{"ab", "z"}));
+
+ Json::Limits lim;
+ lim.regex = 1000;
+ json.limits(lim);
+ EXPECT_EQ(labels(json), unbounded);                            // same range semantics
+ lim.regex = 1;                                                 // literals are counted
+ json.limits(lim);
+ EXPECT_THROW(json.walk("<ab>L"), Json::stdException);
+}
+
+
+
+
+TEST(JSON_test, records_resync_after_truncated_line) {
+ std::vector<size_t> rejects;
+ auto reject = [&rejects](const Json::Reject &r) { rejects.push_back(r.offset); };
+ Json json;
+ json.parse_records("{\"a\":1\n{\"b\":2}\n{\"c\":3}\n", reject);      // truncated line
+ EXPECT_EQ(json.root(), R"([ { "b": 2 }, { "c": 3 } ])"_json.root());
+ EXPECT_EQ(rejects, (std::vector<size_t>{0}));
+
+ rejects.clear();                                               // multi-line record
+ json.parse_records("{\n \"a\": 1,\n \"b\":\n}\n{\"d\":4}\n", reject);
+ EXPECT_EQ(json.root(), R"([ { "d": 4 } ])"_json.root());
+ EXPECT_EQ(rejects, (std::vector<size_t>{0}));
+
+ rejects.clear();                                               // NDJSON of arrays
+ json.parse_records("[1]\n[2, 3]\n[4\n", reject);
+ EXPECT_EQ(json.root(), R"([ [1], [2, 3] ])"_json.root());
+ EXPECT_EQ(rejects, (std::vector<size_t>{11}));
+
+ rejects.clear();                                               // records array, then more
+ json.parse_records("[\n {\"a\":1},\n {\"b\":2}\n]\n{\"c\":3}\n", reject);
+ EXPECT_EQ(json.root(), R"([ { "a": 1 }, { "b": 2 }, { "c": 3 } ])"_json.root());
+ EXPECT_TRUE(rejects.empty());
+}
+
+
+
+
+TEST(JSON_test, tape_mirrors_tree) {
+ Json json = R"({ "a": { "b": [ 1, 2, { "c": "x" } ], "d": true },
+                   "f": [ { "c": 5 }, "x" ] })"_json;
+ Jtape tape(json.root());
+ EXPECT_EQ(tape.size(), json.size());
+ EXPECT_EQ(tape.root()["a"]["b"][1].num(), 2);
+ EXPECT_EQ(tape.root()["f"].children(), 2u);
+ EXPECT_EQ(tape.root()["a"].size(), json["a"].size());          // skip offset
+ EXPECT_THROW(tape.root()["a"]["x"], Jtape::stdException);
+
+ std::stringstream tss, jss;                                    // stringify
+ tss << tape;
+ jss << json;
+ EXPECT_EQ(tss.str(), jss.str());
+
+ Json back{tape.to_jnode()};                                    // mutable again
+ EXPECT_EQ(back, json);
+ EXPECT_EQ(back.size(), json.size());
+ EXPECT_EQ(back.hash(), json.hash());
+ back["a"]["b"].push_back(3.);
+ EXPECT_EQ(back.size(), json.size() + 1);
+ EXPECT_EQ(Json{tape.root()["f"].to_jnode()}, Json{json["f"]});
+
+ for(auto & walk: { "<c>l+0", "<x>+0", "<x>1", "<5>d", "[a][b][+1]", "[f][0][c]",
+                    "[a] <c>l", "[a][b][7]" }) {                // walks as over the tree
+  std::vector<std::string> on_tape, on_tree;
+  for(auto & node: tape.walk(walk))
+   { std::stringstream ss; ss << node; on_tape.push_back(ss.str()); }
+  for(auto it = json.walk(walk); it != it.end(); ++it)
+   { std::stringstream ss; ss << *it; on_tree.push_back(ss.str()); }
+  EXPECT_EQ(on_tape, on_tree) << walk;
+ }
+ EXPECT_THROW(tape.walk("[a][-1]"), Jtape::stdException);
+ EXPECT_THROW(tape.walk("<c>R"), Jtape::stdException);
+
+ std::vector<std::string> visited;                              // pruned traversal
+ tape.traverse([&visited](const Jtape::Node & node, size_t) {
+                if(node.has_label()) visited.push_back(node.label());
+                return not node.has_label() or node.label() != "a";
+               });
+ EXPECT_EQ(visited, (std::vector<std::string>{"a", "f", "c"}));
+}
+
+
+
+
+TEST(JSON_test, concurrent_const_access) {
+ Json json = DOC ""_json;
+ for(double i = 0; i < 100; ++i) json["a"]["b"].push_back(ARY{ i, OBJ{ LBL{"i", i} } });
+ auto h = json.hash(false);
+ size_t size = json.size();
+ Json shared = json.share();
+ json["e"] = 1.;                                                // root's caches are void
+ json["e"] = nullptr;
+
+ std::vector<std::thread> threads;
+ std::vector<uint64_t> hashes(8);
+ std::vector<size_t> sizes(8);
+ for(size_t t = 0; t < hashes.size(); ++t)
+  threads.emplace_back([&, t] {
+   const Json & jn = t % 2 == 0? json: shared;                  // same nodes via both
+   hashes[t] = jn.hash();
+   sizes[t] = jn.size();
+  });
+ for(auto & t: threads) t.join();
+ for(size_t t = 0; t < hashes.size(); ++t)
+  { EXPECT_EQ(hashes[t], h); EXPECT_EQ(sizes[t], size); }
+}
+
+
+
+
+
+int main( int argc, char *argv[]) {
+
+ testing::InitGoogleTest(&argc, argv);
+ return RUN_ALL_TESTS();
+}
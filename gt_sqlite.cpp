@@ -0,0 +1,54 @@
+#include <iostream>
+#include <string>
+#include <gtest/gtest.h>
+#include "lib/Sqlite.hpp"
+
+using namespace std;
+
+/*
+c++ -o us -Wall -std=gnu++14 gt_sqlite.cpp -lgtest -lsqlite3
+*/
+
+
+
+int count_rows(Sqlite &db, const string &tbl) {
+ int n{-1};
+ Sqlite{}.share(db).compile("SELECT count(*) FROM " + tbl + ";") >> n;
+ return n;
+}
+
+
+
+TEST(SQLITE_test, row_source_statement_runs_only_when_executed) {
+ Sqlite::RowSource rs{2};
+ Sqlite db;
+ db.open(":memory:");
+ db.compile("CREATE TABLE a_table (Description TEXT, Rank REAL);");
+ db.row_source("my_rows", rs);
+
+ rs.rows = {{"first line", "0.1"}, {"second line", "0.2"}};     // rows held at compile time
+ db.begin_transaction()
+   .prepare("INSERT INTO a_table (Description, Rank) SELECT * FROM my_rows");
+ EXPECT_EQ(count_rows(db, "a_table"), 0);
+ db.execute();
+ EXPECT_EQ(count_rows(db, "a_table"), 2);
+
+ rs.rows = {{"third line", "0.3"}};
+ db.execute();
+ EXPECT_EQ(count_rows(db, "a_table"), 3);
+ db.end_transaction();
+
+ Sqlite other;                                                  // compile() runs it right away
+ other.share(db).compile("INSERT INTO a_table (Description, Rank) SELECT * FROM my_rows");
+ EXPECT_EQ(count_rows(db, "a_table"), 4);
+}
+
+
+
+
+
+int main( int argc, char *argv[]) {
+
+ testing::InitGoogleTest(&argc, argv);
+ return RUN_ALL_TESTS();
+}
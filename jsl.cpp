@@ -3,11 +3,20 @@
 #include <sstream>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <deque>
+#include <array>
 #include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include "lib/getoptions.hpp"
 #include "lib/Outable.hpp"
 #include "lib/Json.hpp"
 #include "lib/Sqlite.hpp"
+#include "lib/Deflate.hpp"
+#include "lib/Histogram.hpp"
 #include "lib/dbg.hpp"
 
 using namespace std;
@@ -17,17 +26,40 @@ using namespace std;
 
 #define ROW_LMT 2                                               // 2 bytes per autogen. column index
 #define CLM_PFX Auto                                            // name prefix for auto-gen. columns
+#define ROW_SRC jsl_rows                                        // row source (batches) vtab name
+#define VIEW_SFX _recent                                        // suffix of partitions view (-v)
+#define PRG_BATCH 10000                                         // rows per purge batch (-t)
 #define OPT_RDT -
 #define OPT_GEN a
 #define OPT_AIC A
+#define OPT_BAT b
+#define OPT_BUF B
+#define OPT_BLK c
 #define OPT_DBG d
 #define OPT_EXP e
+#define OPT_FMT f
 #define OPT_IGN i
 #define OPT_IGS I
+#define OPT_JIN j
+#define OPT_JFL J
+#define OPT_JKY k
+#define OPT_LIM l
+#define OPT_LAT L
 #define OPT_MAP m
 #define OPT_MPS M
+#define OPT_ITN n
+#define OPT_OUT o
+#define OPT_PRT p
+#define OPT_PFL P
+#define OPT_REJ r
+#define OPT_RLM R
 #define OPT_QET s
+#define OPT_RET t
 #define OPT_CLS u
+#define OPT_VEW v
+#define OPT_WRT w
+#define OPT_ZIP z
+#define OPT_ZDC Z
 #define ARG_DBF 0
 #define ARG_TBL 1
 
@@ -42,9 +74,33 @@ using namespace std;
         RC_OK, \
         RC_NO_TBL, \
         RC_ILL_QUOTING, \
+        RC_NO_PRT_CLM, \
+        RC_ILL_PROFILE, \
+        RC_ILL_FORMAT, \
+        RC_NO_REJ_FILE, \
+        RC_ILL_LIMIT, \
+        RC_REJ_LIMIT, \
+        RC_ILL_RES_LIMIT, \
+        RC_NO_JOIN_FILE, \
+        RC_ILL_JOIN, \
+        RC_ILL_RETENTION, \
+        RC_NO_RET_CLM, \
+        RC_NO_ZIP_CLM, \
+        RC_PRT_CLASH, \
         RC_END
 ENUM(ReturnCodes, RETURN_CODES)
 
+// latencies of pipeline stages (-L)
+#define LATENCIES \
+        LAT_PARSE, \
+        LAT_ASSEMBLE, \
+        LAT_INSERT, \
+        LAT_QUEUE, \
+        LAT_COMMIT, \
+        LAT_END
+ENUM(Latency, LATENCIES)
+typedef array<Histogram, LAT_END> Latencies;
+
 #define OFF_GETOPT RC_END                                       // offset for Getopt exceptions
 #define OFF_JSL (OFF_GETOPT + Getopt::end_of_throw)             // offset for jsl exceptions
 
@@ -79,6 +135,9 @@ struct TableInfo {
 
 
 
+class Partition;
+class Target;
+
 struct SharedResource {
     Getopt              opt;
     Getopt              opr;                                    // option for remapped -m/-e values
@@ -89,6 +148,35 @@ struct SharedResource {
     size_t              attempts{0};                            // # of records attempted into db
     size_t              updates{0};                             // # of updates made into db
     set<string>         ignored;                                // ignored columns (-i, -I)
+    size_t              col_num{0};                             // sequenced column number (-a)
+    Sqlite::RowSource   batch{0};                               // batched rows (-b)
+    string              prt_column;                             // partitioning column (-p)
+    size_t              prt_len{0};                             // partition by value's prefix
+    size_t              prt_buckets{0};                         // partition by hash buckets
+    map<string, unique_ptr<Partition>>
+                        partitions;                             // partitions by key's suffix
+    vector<unique_ptr<Target>>
+                        targets;                                // fan-out targets (-o)
+    unordered_map<string, vector<string>>
+                        join;                                   // joined values by key (-j)
+    vector<string>      join_fields;                            // mapped fields of join input (-J)
+    vector<string>      join_columns;                           // joined columns definitions (-a)
+    size_t              join_key{0};                            // position of key's mapping (-k)
+    size_t              unmatched{0};                           // rows w/o match in join input
+    string              ret_column;                             // retention column (-t)
+    size_t              ret_window{0};                          // retention window (seconds)
+    size_t              ret_batch{PRG_BATCH};                   // rows per purge batch
+    size_t              purged{0};                              // rows purged (-t)
+    set<string>         zip_columns;                            // compressed columns (-z)
+    map<size_t, unique_ptr<Deflate>>
+                        zip;                                    // compressors by row position
+    deque<vector<string>>
+                        zip_pending;                            // rows sampled for training (-Z)
+    size_t              zip_in{0};                              // bytes before compression
+    size_t              zip_out{0};                             // bytes after compression
+    unique_ptr<Latencies>
+                        lat;                                    // latency histograms (-L)
+    Histogram::Timer    row_timer;                              // row assembly start
 
     ostream &           out(unsigned quiet)                     // demux /dev/null & std::cout
                          { return opt[CHR(OPT_QET)].hits()>=quiet? null_: std::cout; }
@@ -111,15 +199,33 @@ class Vstr_maps;
 void post_parse(SharedResource &r);
 void parse_db(SharedResource &r);
 void read_json(SharedResource &r);
+void read_records(SharedResource &r, const string &input);
+void read_join(SharedResource &r);
 void update_table(SharedResource &r);
 
 string columns(SharedResource &r);
-string value_placeholders(SharedResource &r);
-void json_callback(SharedResource &r, Sqlite &db, Vstr_maps &row, const Jnode & node);
-bool schema_generated(SharedResource &r, Sqlite &db, Vstr_maps &row, const Jnode & node);
+string value_placeholders(SharedResource &r, bool row_source = false);
+void compile_update(SharedResource &r, Sqlite &db);
+void compress_row(SharedResource &r, Sqlite &db, vector<string> &&row);
+void train_dictionaries(SharedResource &r, Sqlite &db);
+void store_dictionaries(SharedResource &r, Sqlite &db);
+void emit_row(SharedResource &r, Sqlite &db, vector<string> &&row, const string *key = nullptr);
+void flush_batch(SharedResource &r, Sqlite &db);
+void route_row(SharedResource &r, Sqlite &db, vector<string> &&row, const string *key);
+void close_partitions(SharedResource &r, Sqlite &db);
+void update_view(SharedResource &r, Sqlite &db);
+const vector<string> & pragma_profile(const string &profile);
+void close_targets(SharedResource &r);
+void merge_latencies(SharedResource &r, const Latencies *lat);
+void report_latencies(SharedResource &r);
+size_t purge_rows(SharedResource &r, Sqlite &db, const string &table);
+void json_callback(SharedResource &r, Sqlite &db, Vstr_maps &row, Vstr_maps &cschema,
+                   const Jnode & node);
+bool schema_generated(SharedResource &r, Sqlite &db, Vstr_maps &row, Vstr_maps &cschema,
+                      const Jnode & node);
 string stringify(const Jnode &node);
 string & trim_spaces(std::string &&str);
-string generate_column_name(const Jnode &jn);
+string generate_column_name(SharedResource &r, const Jnode &jn, const string &spec = "");
 string maybe_quote(string str);
 
 
@@ -137,6 +243,8 @@ class Vstr_maps {
  // thus, the container (de)multiplexes both container types
  // it also provides back-tracing of ordinal encounter of option -m to the mapped
  // container (vector)
+ // labels are mapped by their specs (maybe scoped), as the same label may be mapped
+ // in a few scopes: the spec of a label being called back is recorded in spec_
  public:
     #define MAPTYPE \
                 label, \
@@ -145,7 +253,12 @@ class Vstr_maps {
     ENUM(MapType, MAPTYPE)
 
                         Vstr_maps(void) = delete;
-                        Vstr_maps(SharedResource &r): r_(r) {}
+                        Vstr_maps(SharedResource &r): spec_(make_shared<string>()), r_(r) {}
+    Vstr_maps &         operator=(const Vstr_maps &m) {         // copy mappings (r_ is the same)
+                         lbl_ = m.lbl_; itr_ = m.itr_; lon_ = m.lon_; ion_ = m.ion_;
+                         spec_ = m.spec_;                       // spec_ is shared by copies
+                         return *this;
+                        }
 
     void                book(const string &key, function<void(const Jnode &)> &&cb, size_t opt_cnt);
     size_t              size(void) const;
@@ -156,34 +269,127 @@ class Vstr_maps {
  const vector<string> * value_by_position(size_t opt_cnt) const;
  const vector<string> & value_by_node(const Jnode &jn) const;
     MapType             mapped_type(size_t opt_cnt) const;
+    const string &      label_by_position(size_t opt_cnt) const;
+    const string &      called_label(void) const { return *spec_; }
 
  protected:
     lbl_vstr_map        lbl_;                                   // mappings for lables
     itn_vstr_map        itr_;                                   // mapping for iterators
     lbl_opt             lon_;                                   // label to option counter map
     itn_opt             ion_;                                   // iterator to option counter map
+    shared_ptr<string>  spec_;                                  // spec of label being called back
 
     SharedResource &    r_;
 };
 #undef MAPTYPE
 
 
+
+class DbWriter {
+ // a db writer: a table update with own prepared statement, rows could be written by own
+ // writer thread (buffering up to a given number of rows), committed every so many rows
+ public:
+                        DbWriter(void) = default;
+    virtual            ~DbWriter(void)                         // abandoned: no purge
+                         { if(writer_.joinable()) abandon_(); }
+
+    const string &      name(void) const { return name_; }
+    void                write(vector<string> &&row);
+    void                close(void);                            // flush, join writer, close db
+    size_t              attempts(void) const { return attempts_; }
+    size_t              updates(void) const { return updates_; }
+    size_t              purged(void) const { return purged_; }
+    const Latencies *   latencies(void) const { return lat_.get(); }
+
+ protected:
+    void                start_(size_t buffer);                  // start writer thread
+    void                insert_(vector<string> &row);
+    void                writer_loop_(void);
+    void                abandon_(void) noexcept;
+
+    Sqlite              db_;
+    string              name_;                                  // partition table / target name
+    string              update_;                                // update sql statement
+    size_t              commit_{0};                             // commit every # rows (0: once)
+    size_t              uncommitted_{0};
+    size_t              attempts_{0};
+    size_t              updates_{0};
+    std::function<size_t(Sqlite &)>
+                        purge_;                                 // retention purge (-t)
+    size_t              purged_{0};
+    std::function<void(Sqlite &)>
+                        store_;                                 // store dictionaries (-Z)
+
+    std::thread         writer_;                                // writer thread
+    std::mutex          mtx_;                                   // guards queue_, done_, error_
+    std::condition_variable
+                        ready_;                                 // rows queued, or done
+    std::condition_variable
+                        room_;                                  // queue has room
+    deque<vector<string>>
+                        queue_;                                 // rows queued for writer
+    deque<Histogram::Timer>
+                        queued_;                                // rows queueing times (-L)
+    unique_ptr<Latencies>
+                        lat_;                                   // own latency histograms (-L)
+    size_t              buffer_{SIZE_MAX};                      // max rows in queue
+    bool                done_{false};
+    std::exception_ptr  error_;                                 // exception raised in writer
+};
+
+
+
+class Partition: public DbWriter {
+ // a partition (-p) is either a table in the user's db (sharing its connection), or a table
+ // in own db file (-P); rows into partition files could be written by own thread (-w)
+ public:
+                        Partition(SharedResource &r, Sqlite &db, const string &suffix,
+                                  const string &key);
+
+    const string &      key(void) const { return key_; }
+
+ private:
+    string              key_;                                   // key (value) of partition rows
+};
+
+
+
+class Target: public DbWriter {
+ // a fan-out target (-o): the same rows are written into another db file by own writer
+ // thread, with own commit policy and pragma profile
+ public:
+                        Target(SharedResource &r, const string &spec);
+};
+
+
 void Vstr_maps::book(const string &key, function<void(const Jnode &)> &&cb, size_t on) {
  // book place either in itr or lbl: predicated key being walk-path or label
  try {
   Json::iterator it = r_.json.walk(key, Json::keep_cache);      // first try parse as a walk
   if(it == r_.json.end()) return;                               // walk failed - don't register
-  r_.json.callback(move(it), move(cb));                         // plug itr callback here
+  r_.json.callback(move(it), [spec = spec_, cb = move(cb)](const Jnode &jn)
+                              { spec->clear(); cb(jn); });      // plug itr callback here
   itr_[r_.json.itr_callbacks().size()-1];
   ion_[r_.json.itr_callbacks().size()-1] = on;                  // also record -m ordinal num
   DBG(r_, 0) DOUT(r_) << "booked iterator based callback: " << key << endl;
  }
  catch(Json::stdException & e) {
   if(e.code() < Jnode::walk_offset_missing_closure) throw e;    // if failed with walk exception
-  r_.json.callback(key, move(cb));                              // plug lbl callback
-  lbl_[key];                                                    // then it's a label
+  string label = key, parent;                                   // then it's a label, maybe scoped:
+  size_t depth = 0;                                             // [parent/]label[@depth]
+  auto found = label.rfind('@');
+  if(found != string::npos and found + 1 < label.size() and
+     label.find_first_not_of("0123456789", found + 1) == string::npos)
+   { depth = stoul(label.substr(found + 1)); label.erase(found); }
+  found = label.find('/');
+  if(found != string::npos and found > 0 and found + 1 < label.size())
+   { parent = label.substr(0, found); label.erase(0, found + 1); }
+  r_.json.callback(label, depth, parent, [spec = spec_, key, cb = move(cb)](const Jnode &jn)
+                                          { *spec = key; cb(jn); });    // plug lbl callback
+  lbl_[key];
   lon_[key] = on;                                               // it's required to trace prev. opt.
-  DBG(r_, 0) DOUT(r_) << "booked label based holder: " << key << endl;
+  DBG(r_, 0) DOUT(r_) << "booked label based holder: " << label << " (parent: " << parent
+                      << ", depth: " << depth << ")" << endl;
  }
 }
 
@@ -216,9 +422,8 @@ bool Vstr_maps::complete(void) const {
 
 void Vstr_maps::push(const Jnode &jn, const string &&json_value) {
  // update string value into lbl or itr map
- if(jn.has_label())                                             // first check lbl mapping
-  if(lbl_.count(jn.label()) == 1)
-   { lbl_[jn.label()].push_back(move(json_value)); return; }
+ if(lbl_.count(*spec_) == 1)                                    // first check lbl mapping
+  { lbl_[*spec_].push_back(move(json_value)); return; }
  for(auto &itn_vec: itr_) {                                     // then check itr mapping
   auto & iter = r_.json.itr_callbacks()[itn_vec.first].iter;
   if(&jn.value() == &iter->value())                             // &jn matches to pointer of itr
@@ -232,9 +437,8 @@ void Vstr_maps::push(const Jnode &jn, const string &&json_value) {
 
 size_t Vstr_maps::backtrace_opt(const Jnode &jn) const {
  // given Jnode (jn) back trace the option count that called it
- if(jn.has_label())                                             // first check lbl mapping
-  if(lon_.count(jn.label()) == 1)
-   return lon_.at(jn.label());
+ if(lon_.count(*spec_) == 1)                                    // first check lbl mapping
+  return lon_.at(*spec_);
 
  for(auto &itn_vec: itr_) {                                     // then check itr vector
   auto & iter = r_.json.itr_callbacks()[itn_vec.first].iter;
@@ -262,9 +466,8 @@ const vector<string> * Vstr_maps::value_by_position(size_t opt_cnt) const {
 
 const vector<string> & Vstr_maps::value_by_node(const Jnode &jn) const {
  // return array of mapped values for given jnode
- if(jn.has_label())                                             // first check lbl mapping
-  if(lbl_.count(jn.label()) == 1)
-   return lbl_.at(jn.label());
+ if(lbl_.count(*spec_) == 1)                                    // first check lbl mapping
+  return lbl_.at(*spec_);
  for(auto &itn_vec: itr_) {                                     // then check itr mapping
   auto & iter = r_.json.itr_callbacks()[itn_vec.first].iter;
   if(&jn.value() == &iter->value())                             // &jn matches to pointer of iter
@@ -275,6 +478,16 @@ const vector<string> & Vstr_maps::value_by_node(const Jnode &jn) const {
 }
 
 
+const string & Vstr_maps::label_by_position(size_t opt_cnt) const {
+ // return label spec mapped at given option position (empty if not mapped to a label)
+ static const string none;
+ for(auto & lbl_cnt: lon_)
+  if(lbl_cnt.second == opt_cnt)
+   return lbl_cnt.first;
+ return none;
+}
+
+
 Vstr_maps::MapType Vstr_maps::mapped_type(size_t opt_cnt) const {
  // return true/false if given option position maps to label or to iterator
  for(auto & lbl_cnt: lon_)
@@ -295,6 +508,191 @@ Vstr_maps::MapType Vstr_maps::mapped_type(size_t opt_cnt) const {
 
 
 
+void DbWriter::write(vector<string> &&row) {
+ if(not writer_.joinable())
+  { insert_(row); return; }
+ {
+  std::unique_lock<std::mutex> lock(mtx_);
+  room_.wait(lock, [this]{ return error_ or queue_.size() < buffer_; });  // block if buffer full
+  if(error_) {                                                  // writer is gone: relay its error
+   purge_ = nullptr;                                            // once: close() then won't
+   store_ = nullptr;
+   std::exception_ptr error;
+   swap(error, error_);
+   std::rethrow_exception(error);
+  }
+  queue_.push_back( move(row) );
+  if(lat_) queued_.emplace_back();
+ }
+ ready_.notify_one();
+}
+
+
+
+void DbWriter::close(void) {
+ if(writer_.joinable()) {
+  { std::lock_guard<std::mutex> lock(mtx_); done_ = true; }
+  ready_.notify_one();
+  writer_.join();
+ }
+ if(store_ and not error_) store_(db_);                         // in the last transaction
+ if(purge_ and not error_) purged_ = purge_(db_);
+ Histogram::Timer commit;
+ bool own = not db_.is_shared();                                // shared db is committed by owner
+ db_.close();
+ if(lat_ and own) (*lat_)[LAT_COMMIT].record(commit.elapsed());
+ if(error_) std::rethrow_exception(error_);                     // relay writer's exception
+}
+
+
+
+void DbWriter::abandon_(void) noexcept {
+ // join the writer of a writer never closed: destructor may run when stack unwinds, hence
+ // writer's exception is only reported (an explicit close() relays it)
+ purge_ = nullptr;
+ store_ = nullptr;
+ try { close(); }
+ catch(std::exception &e)
+  { cerr << "error: abandoned writer " << name_ << " failed: " << e.what() << endl; }
+ catch(...)
+  { cerr << "error: abandoned writer " << name_ << " failed" << endl; }
+}
+
+
+
+void DbWriter::start_(size_t buffer) {
+ buffer_ = buffer == 0? 1: buffer;
+ writer_ = std::thread(&DbWriter::writer_loop_, this);
+}
+
+
+
+void DbWriter::insert_(vector<string> &row) {
+ Histogram::Timer insert;
+ db_ << row;
+ if(lat_) (*lat_)[LAT_INSERT].record(insert.elapsed());
+ ++attempts_;
+ if(db_.rc() AMONG(SQLITE_OK, SQLITE_DONE))
+  ++updates_;
+ if(commit_ > 0 and ++uncommitted_ >= commit_) {                // commit policy
+  Histogram::Timer commit;
+  db_.end_transaction().begin_transaction().compile(update_);
+  if(lat_) (*lat_)[LAT_COMMIT].record(commit.elapsed());
+  uncommitted_ = 0;
+ }
+}
+
+
+
+void DbWriter::writer_loop_(void) {
+ // write queued rows until closed
+ try {
+  deque<vector<string>> rows;
+  deque<Histogram::Timer> queued;
+  while(true) {
+   {
+    std::unique_lock<std::mutex> lock(mtx_);
+    ready_.wait(lock, [this]{ return done_ or not queue_.empty(); });
+    if(queue_.empty()) return;                                  // done and all written
+    rows.swap(queue_);
+    queued.swap(queued_);
+   }
+   room_.notify_one();
+   for(size_t i = 0; i < rows.size(); ++i) {
+    if(lat_) (*lat_)[LAT_QUEUE].record(queued[i].elapsed());   // queue wait till written
+    insert_(rows[i]);
+   }
+   rows.clear();
+   queued.clear();
+  }
+ }
+ catch(...) {
+  { std::lock_guard<std::mutex> lock(mtx_); error_ = std::current_exception(); }
+  room_.notify_all();                                           // unblock a waiting producer
+ }
+}
+
+
+
+Partition::Partition(SharedResource &r, Sqlite &db, const string &suffix, const string &key):
+ key_{key} {
+ // create partition table (from base table's schema) and compile update statement; suffix
+ // is the key as it goes into the table (file) name, see partition_suffix()
+ REVEAL(r, opt, schema, tbl_name, DBG())
+ DBG().severity(db_);
+ if(r.lat) lat_.reset(new Latencies);
+
+ string table = opt[CHR(OPT_PFL)].hits() > 0? tbl_name: tbl_name + "_" + suffix;
+ string create = "CREATE TABLE IF NOT EXISTS " + maybe_quote(table) + " " +
+                 schema.substr(schema.find('('));
+ update_ = opt[CHR(OPT_CLS)].str() + " INTO " + maybe_quote(table) + columns(r) +
+           " VALUES (" + value_placeholders(r) + ");";
+
+ if(opt[CHR(OPT_PFL)].hits() > 0) {                             // partition in own db file
+  string file = opt[ARG_DBF].str();
+  auto dot = file.rfind('.');
+  if(dot == string::npos or file.find('/', dot) != string::npos) dot = file.size();
+  name_ = file.insert(dot, "_" + suffix);
+  db_.open(name_).compile(create);
+  db_.begin_transaction().compile(update_);
+  if(opt[CHR(OPT_ZDC)].hits() > 0)
+   store_ = [&r](Sqlite &db) { store_dictionaries(r, db); };
+  if(opt[CHR(OPT_WRT)].hits() > 0) start_(SIZE_MAX);
+ }
+ else {                                                         // table in user's db
+  name_ = table;
+  Sqlite{}.share(db).compile(create);
+  db_.share(db).compile(update_);
+ }
+ if(opt[CHR(OPT_RET)].hits() > 0)
+  purge_ = [&r, table](Sqlite &db) { return purge_rows(r, db, table); };
+ DBG(0) DOUT() << "created partition '" << name_ << "' for key: " << key << endl;
+}
+
+
+
+Target::Target(SharedResource &r, const string &spec) {
+ // spec: db_file[:profile[:commit_rows]], see -o notes
+ REVEAL(r, opt, schema, tbl_name, DBG())
+ DBG().severity(db_);
+ if(r.lat) lat_.reset(new Latencies);
+
+ auto found = spec.find(':');
+ name_ = spec.substr(0, found);
+ string profile = found == string::npos? "": spec.substr(found + 1);
+ found = profile.find(':');
+ if(found != string::npos) {
+  commit_ = strtoul(profile.c_str() + found + 1, nullptr, 10);
+  profile.erase(found);
+ }
+
+ db_.open(name_);
+ for(auto &pragma: pragma_profile(profile)) {
+  string ignore;                                                // journal_mode returns a row
+  db_.compile(pragma);
+  if(db_.column_count() > 0) db_ >> ignore;
+ }
+ db_.compile("CREATE TABLE IF NOT EXISTS " + maybe_quote(tbl_name) + " " +
+             schema.substr(schema.find('(')));
+ update_ = opt[CHR(OPT_CLS)].str() + " INTO " + maybe_quote(tbl_name) + columns(r) +
+           " VALUES (" + value_placeholders(r) + ");";
+ db_.begin_transaction().compile(update_);
+ if(opt[CHR(OPT_RET)].hits() > 0)
+  purge_ = [&r](Sqlite &db) { return purge_rows(r, db, r.tbl_name); };
+ if(opt[CHR(OPT_ZDC)].hits() > 0)
+  store_ = [&r](Sqlite &db) { store_dictionaries(r, db); };
+ start_(opt[CHR(OPT_BUF)]);
+ DBG(0) DOUT() << "fan-out target '" << name_ << "', profile: " << profile
+               << ", commit every: " << commit_ << endl;
+}
+
+
+
+
+
+
+
+
 int main(int argc, char *argv[]) {
 
  SharedResource r;
@@ -305,16 +703,52 @@ int main(int argc, char *argv[]) {
  opt[CHR(OPT_GEN)].desc("auto-generate table schema from JSON values (if not in db yet)");
  opt[CHR(OPT_AIC)].desc("auto-generate table schema with primary column becoming a ROWID")
                   .name("column");
+ opt[CHR(OPT_BAT)].desc("insert rows in batches of given size (0: insert each row)")
+                  .name("rows").bind("0");
+ opt[CHR(OPT_BUF)].desc("rows buffered per fan-out target (-" STR(OPT_OUT) ")")
+                  .name("rows").bind("10000");
+ opt[CHR(OPT_BLK)].desc("tune sqlite for bulk loads (slab page cache, lean memory settings)");
  opt[CHR(OPT_DBG)].desc("turn on debugs (multiple calls increase verbosity)");
  opt[CHR(OPT_EXP)].desc("expand followed mapping if it's a JSON array or object");
+ opt[CHR(OPT_FMT)].desc("input format: json, cbor, msgpack, or auto (detected)")
+                  .name("format").bind("auto");
  opt[CHR(OPT_IGN)].desc("ignore a specified column").name("tbl_column");
  opt[CHR(OPT_IGS)].desc("ignore all listed columns (comma separated list)").name("header-list");
+ opt[CHR(OPT_JIN)].desc("enrich rows from another JSON input by a join key (see notes below)")
+                  .name("file:key");
+ opt[CHR(OPT_JFL)].desc("map fields of joined records (comma separated) to next columns")
+                  .name("label-list");
+ opt[CHR(OPT_JKY)].desc("join key of the input: one of mapped labels/walks (-" STR(OPT_MAP) ")")
+                  .name("label_walk");
+ opt[CHR(OPT_LIM)].desc("limit parsing/walking resources (see notes below)")
+                  .name("limit=N[,...]");
+ opt[CHR(OPT_LAT)].desc("report latencies of pipeline stages: table, or json (see notes below)")
+                  .name("format");
  opt[CHR(OPT_MAP)].desc("map a single label or walk-path onto a respective table column")
                   .name("label_walk");
  opt[CHR(OPT_MPS)].desc("map JSON labels/walks (comma separated) to respective columns")
                   .name("label-list");
+ opt[CHR(OPT_ITN)].desc("intern identical subtrees of JSON input (store each one once)");
+ opt[CHR(OPT_OUT)].desc("fan out rows also into another db (see notes below)")
+                  .name("db_file[:profile[:commit]]");
+ opt[CHR(OPT_PRT)].desc("route rows into partitions by a column's value (see notes below)")
+                  .name("column[:len|%buckets]");
+ opt[CHR(OPT_PFL)].desc("make partitions in own db files (instead of tables)");
+ opt[CHR(OPT_REJ)].desc("skip malformed records writing them into a file (see notes below)")
+                  .name("reject_file");
+ opt[CHR(OPT_RLM)].desc("abort if rejected records exceed given number (or rate: N%)")
+                  .name("max_rejects");
  opt[CHR(OPT_QET)].desc("run quietly (multiple calls reduce verbocity)");
+ opt[CHR(OPT_RET)].desc("purge rows older than given window (see notes below)")
+                  .name("column:window[:batch]");
  opt[CHR(OPT_CLS)].desc("sql update clause").bind("INSERT OR REPLACE").name("clause");
+ opt[CHR(OPT_VEW)].desc("maintain view (UNION ALL) over given number of recent partitions")
+                  .name("partitions");
+ opt[CHR(OPT_WRT)].desc("write each partition db file in own thread (with -" STR(OPT_PFL) ")");
+ opt[CHR(OPT_ZIP)].desc("compress values of listed columns (comma separated, see notes below)")
+                  .name("column-list");
+ opt[CHR(OPT_ZDC)].desc("compress with dictionaries trained on given number of first rows")
+                  .name("rows");
  opt[ARG_DBF].desc("sqlite db file").name("db_file");
  opt[ARG_TBL].desc("sqlite db table to update").name("table").bind("auto-selected first in db");
  opt.epilog("\nNote on -" STR(OPT_MAP) " and -" STR(OPT_MPS) " usage:\n\
@@ -323,6 +757,9 @@ int main(int argc, char *argv[]) {
    over comma; option -" STR(OPT_MPS) " is expanded into respective number of -"
    STR(OPT_MAP) " options, the\n\
    order and relevance with other options is preserved\n\
+ - a mapped label could be scoped as [parent/]label[@depth]: then only labels found\n\
+   under the given parent label (the closest labeled ancestor), and/or at the given\n\
+   depth (root's children are at depth 1) are mapped, e.g.: -" STR(OPT_MAP) " address/city\n\
  - option -" STR(OPT_EXP)
    " lets expanding a given label (if it's expandable): i.e. a label\n\
    may map onto a JSON array or object, if -" STR(OPT_EXP)
@@ -339,6 +776,71 @@ Note on -" STR(OPT_IGN) " and -" STR(OPT_IGS) " usage:\n\
    specifying): ROWID is the single PRIMARY KEY column with type INTEGER, which\n\
    is incremented automatically\n\
  - option -" STR(OPT_AIC) " auto-generates such ROWID column\n\n\
+Note on -" STR(OPT_REJ) " usage:\n\
+ - the input is read as records: a JSON array of records, or NDJSON (a record per\n\
+   line); a malformed record is written into the reject file (preceded by a line with\n\
+   its byte offset and the parsing error) and loading continues with the next record\n\
+   (next array element, or next line); with -" STR(OPT_RLM) " the run is aborted (before any\n\
+   loading) if rejects exceed the given count, or rate of records (e.g.: -" STR(OPT_RLM) " 1%)\n\
+ - applies only to JSON text: binary input (CBOR, MessagePack) is decoded as a whole\n\n\
+Note on -" STR(OPT_JIN) ", -" STR(OPT_JFL) " and -" STR(OPT_JKY) " usage:\n\
+ - the join input (records: a JSON array, or NDJSON) is loaded first into a hash table by\n\
+   the given key (a record's label or a walk-path relative to a record, e.g.: catalog.json:id);\n\
+   each row is then looked up by the value of the -" STR(OPT_JKY)
+   " mapping and enriched with values of\n\
+   the matched record's fields (-" STR(OPT_JFL)
+   ") - they go into columns following the mapped ones;\n\
+   rows w/o a match are skipped (inner join), with duplicate keys the first record is used\n\n\
+Note on -" STR(OPT_RET) " usage:\n\
+ - once rows are loaded, rows with the column's value older than the window (N[s|m|h|d],\n\
+   e.g.: -" STR(OPT_RET) " ts:30d) are purged from the table (also from partitions and fan-out\n\
+   targets) within the load's transaction; the column holds either epoch seconds (numeric\n\
+   type), or sqlite datetime text (YYYY-MM-DD HH:MM:SS); rows are deleted by ranges of the\n\
+   column's index (created if missing) in batches of given number of rows (" STR(PRG_BATCH) ")\n\n\
+Note on -" STR(OPT_ZIP) " and -" STR(OPT_ZDC) " usage:\n\
+ - values of listed columns are stored as BLOBs holding zlib streams, SQL function\n\
+   jsl_decompress(column) returns them as text (the function is available to other readers\n\
+   as a sqlite extension: jsl_ext.cpp); with -" STR(OPT_ZDC)
+   " a preset dictionary per column is trained on\n\
+   values of the first given number of rows (e.g.: -" STR(OPT_ZDC)
+   " 1000) and stored in table " DFL_DICT_TBL ";\n\
+   dictionaries benefit mostly values of similar content (e.g., JSON of the same layout)\n\n\
+Note on -" STR(OPT_LIM) " usage:\n\
+ - guards against pathological input: limits are given as a comma separated list of\n\
+   depth (nesting of arrays/objects), string, number (lengths in characters), nodes\n\
+   (values and labels in the input, or in a record with -" STR(OPT_REJ) "), regex (steps per a\n\
+   walk regex evaluation), e.g.: -" STR(OPT_LIM)
+   " depth=64,string=1048576,regex=100000;\n\
+   exceeding a limit fails the run (or rejects the record with -" STR(OPT_REJ) ");\n\
+   binary input (CBOR, MessagePack) is guarded by depth, string and nodes limits only\n\n\
+Note on -" STR(OPT_LAT) " usage:\n\
+ - latencies are recorded into histograms (resolution ~1.6%) and reported once loading is\n\
+   complete as percentiles (microseconds) for stages: parse (a record with -" STR(OPT_REJ)
+   ", otherwise\n\
+   entire input), assemble (a row: from its first mapped value until it's complete), insert\n\
+   (a row, or a batch with -" STR(OPT_BAT) "), queue (a row waiting in a writer's queue with -"
+   STR(OPT_OUT) ", -" STR(OPT_WRT) "),\n\
+   commit (a transaction)\n\n\
+Note on -" STR(OPT_FMT) " usage:\n\
+ - besides JSON text, input could be CBOR or MessagePack (decoded into the same JSON\n\
+   tree, so mapping works the same way); format 'auto' tells binary input by the\n\
+   first byte (or by CBOR self-described tag), a sequence of items is read as an array\n\n\
+Note on -" STR(OPT_PRT) " usage:\n\
+ - each row is routed into a partition by the value of the given column: either by\n\
+   entire value, by its prefix of given length (e.g.: -" STR(OPT_PRT) " timestamp:10 - by date),\n\
+   or by hash buckets (e.g.: -" STR(OPT_PRT) " Name%16); partitions are created from the table's\n\
+   schema as tables <table>_<key>, or (with -" STR(OPT_PFL) ") as tables in files\n\
+   <db_file>_<key>; option -" STR(OPT_VEW) " maintains view <table>" STR(VIEW_SFX)
+   " over recent partition tables\n\
+   (by key), option -" STR(OPT_BAT) " does not apply to partitioned rows\n\
+ - characters of a key other than letters and digits become '_' in the partition's name:\n\
+   keys which end up with the same name (e.g.: 2024-01-01 and 2024_01_01) are an error\n\n\
+Note on -" STR(OPT_OUT) " usage:\n\
+ - each row is also written into the table in given db file (created from the table's\n\
+   schema if missing) by a dedicated thread, buffering up to -" STR(OPT_BUF)
+   " rows; optional profile\n\
+   sets db pragmas: fast (no sync, journal in memory), wal (WAL, normal sync), safe\n\
+   (full sync); optional commit is the number of rows per transaction (0: one)\n\n\
 For understanding walk-path refer to https://github.com/ldn-softdev/jtc\n");
 
  // parse options
@@ -350,17 +852,22 @@ For understanding walk-path refer to https://github.com/ldn-softdev/jtc\n");
       .use_ostream(cerr)
       .severity(json);
  post_parse(r);
+ if(opt[CHR(OPT_BLK)].hits() > 0)                               // must precede opening db
+  if(Sqlite::tune_for_bulk_load() != SQLITE_OK)
+   cerr << "warning: failed tuning sqlite for bulk loads, proceeding with defaults" << endl;
 
  try {
   parse_db(r);
   if(tbl_name.empty() and opt[CHR(OPT_GEN)].hits() == 0)        // some wrong table name given
    { cerr << "error: no table " << opt[ARG_TBL] << " found in db" << endl; return RC_NO_TBL; }
 
+  if(opt[CHR(OPT_JIN)].hits() > 0) read_join(r);
   read_json(r);
   update_table(r);
   r.out(3) << "attempted " << attempts << " updates, updated " 
            << updates << " records into " << opt[ARG_DBF].str()
            << ", table: " << tbl_name << endl;
+  if(r.lat) report_latencies(r);
  }
  catch(Sqlite::stdException &e) {
   DBG(0) DOUT() << "exception raised by: " << e.where() << endl;
@@ -377,6 +884,21 @@ For understanding walk-path refer to https://github.com/ldn-softdev/jtc\n");
   cerr << opt.prog_name() << " Json exception: " << e.what() << endl;
   return e.code() + OFF_JSL;
  }
+ catch(Jbin::stdException &e) {
+  DBG(0) DOUT() << "exception raised by: " << e.where() << endl;
+  cerr << opt.prog_name() << " Jbin exception: " << e.what() << endl;
+  return e.code() + OFF_JSL;
+ }
+ catch(Deflate::stdException &e) {
+  DBG(0) DOUT() << "exception raised by: " << e.where() << endl;
+  cerr << opt.prog_name() << " Deflate exception: " << e.what() << endl;
+  return e.code() + OFF_JSL;
+ }
+ catch(Blob::stdException &e) {
+  DBG(0) DOUT() << "exception raised by: " << e.where() << endl;
+  cerr << opt.prog_name() << " Blob exception: " << e.what() << endl;
+  return e.code() + OFF_JSL;
+ }
 
  return RC_OK;
 }
@@ -425,6 +947,113 @@ void post_parse(SharedResource &r) {
   }
 
  opt[CHR(OPT_GEN)] = opt[CHR(OPT_AIC)].str();                   // move value of -A to -a
+
+ if(opt[CHR(OPT_RLM)].hits() > 0) {                             // validate -R: N or N%
+  char *end;
+  strtod(opt[CHR(OPT_RLM)].str().c_str(), &end);
+  if(end == opt[CHR(OPT_RLM)].str().c_str() or not (*end == '\0' or string(end) == "%"))
+   { cerr << "error: illegal reject limit: " << opt[CHR(OPT_RLM)].str() << endl;
+     exit(RC_ILL_LIMIT); }
+ }
+
+ if(opt[CHR(OPT_LIM)].hits() > 0) {                             // parse -l limit=N,...
+  Json::Limits lim;
+  map<string, size_t *> limits{{"depth", &lim.depth}, {"string", &lim.string},
+                               {"number", &lim.number}, {"nodes", &lim.nodes},
+                               {"regex", &lim.regex}};
+  const string & spec = opt[CHR(OPT_LIM)].str();
+  for(size_t last = 0, found = 0; found != string::npos; last = found + 1) {
+   found = spec.find(",", last);
+   string limit = trim_spaces(spec.substr(last, found - last));
+   auto eq = limit.find('=');
+   auto it = limits.find(limit.substr(0, eq));
+   char *end = nullptr;
+   if(it != limits.end() and eq != string::npos and isdigit(limit[eq + 1]))
+    *it->second = strtoul(limit.c_str() + eq + 1, &end, 10);
+   if(end == nullptr or *end != '\0')
+    { cerr << "error: illegal resource limit: " << limit << endl; exit(RC_ILL_RES_LIMIT); }
+  }
+  r.json.limits(lim);
+  DBG(0) DOUT() << "resource limits: depth " << lim.depth << ", string " << lim.string
+                << ", number " << lim.number << ", nodes " << lim.nodes
+                << ", regex " << lim.regex << endl;
+ }
+
+ if(opt[CHR(OPT_ITN)].hits() > 0) {                             // share identical subtrees
+  r.json.intern_subtrees();
+  DBG(0) DOUT() << "interning identical subtrees of the input" << endl;
+ }
+
+ if(opt[CHR(OPT_JIN)].hits() + opt[CHR(OPT_JFL)].hits() + opt[CHR(OPT_JKY)].hits() > 0) {
+  if(opt[CHR(OPT_JIN)].str().find(':') == string::npos or opt[CHR(OPT_JKY)].hits() == 0)
+   { cerr << "error: join requires -" STR(OPT_JIN) " file:key and -" STR(OPT_JKY) " label_walk"
+          << endl; exit(RC_ILL_JOIN); }
+  size_t pos = 0;                                               // locate the key's mapping (-m)
+  for(const auto &mapped_lbl: opr[CHR(OPT_MAP)])
+   if(++pos, mapped_lbl == opt[CHR(OPT_JKY)].str()) { r.join_key = pos; break; }
+  if(r.join_key == 0)
+   { cerr << "error: join key is not mapped: " << opt[CHR(OPT_JKY)].str() << endl;
+     exit(RC_ILL_JOIN); }
+  if(opt[CHR(OPT_JFL)].hits() > 0)                              // break up -J
+   for(size_t last = 0, found = 0; found != string::npos; last = found + 1) {
+    found = opt[CHR(OPT_JFL)].str().find(",", last);
+    r.join_fields.push_back(trim_spaces(opt[CHR(OPT_JFL)].str().substr(last, found - last)));
+   }
+ }
+
+ if(opt[CHR(OPT_RET)].hits() > 0) {                             // parse -t column:window[:batch]
+  string spec = opt[CHR(OPT_RET)].str();
+  auto found = spec.find(':');
+  r.ret_column = spec.substr(0, found);
+  char *end = nullptr;
+  if(found != string::npos and isdigit(spec[found + 1]))
+   r.ret_window = strtoul(spec.c_str() + found + 1, &end, 10);
+  static const map<char, size_t> units{{'s', 1}, {'m', 60}, {'h', 3600}, {'d', 86400}};
+  if(end != nullptr and units.count(*end) == 1) r.ret_window *= units.at(*end++);
+  else if(end != nullptr and (*end == '\0' or *end == ':')) r.ret_window *= units.at('d');
+  if(end != nullptr and *end == ':')
+   r.ret_batch = isdigit(*++end)? strtoul(end, &end, 10): 0;
+  if(r.ret_column.empty() or end == nullptr or *end != '\0' or r.ret_batch == 0)
+   { cerr << "error: illegal retention: " << spec << endl; exit(RC_ILL_RETENTION); }
+  DBG(0) DOUT() << "retention column: " << r.ret_column << ", window: " << r.ret_window
+                << "s, purge batch: " << r.ret_batch << endl;
+ }
+
+ if(opt[CHR(OPT_ZIP)].hits() > 0)                               // break up -z
+  for(size_t last = 0, found = 0; found != string::npos; last = found + 1) {
+   found = opt[CHR(OPT_ZIP)].str().find(",", last);
+   r.zip_columns.insert(trim_spaces(opt[CHR(OPT_ZIP)].str().substr(last, found - last)));
+  }
+
+ if(opt[CHR(OPT_LAT)].hits() > 0) {                             // validate -L format
+  if(opt[CHR(OPT_LAT)].str() != "table" and opt[CHR(OPT_LAT)].str() != "json")
+   { cerr << "error: unknown latency report format: " << opt[CHR(OPT_LAT)].str() << endl;
+     exit(RC_ILL_FORMAT); }
+  r.lat.reset(new Latencies);
+ }
+
+ static const set<string> formats{"auto", "json", "cbor", "msgpack"};
+ if(formats.count(opt[CHR(OPT_FMT)].str()) == 0)
+  { cerr << "error: unknown input format: " << opt[CHR(OPT_FMT)].str() << endl;
+    exit(RC_ILL_FORMAT); }
+
+ for(const auto &spec: opt[CHR(OPT_OUT)]) {                     // validate -o profiles early
+  auto found = spec.find(':');
+  if(found != string::npos)
+   pragma_profile(spec.substr(found + 1, spec.find(':', found + 1) - found - 1));
+ }
+
+ if(opt[CHR(OPT_PRT)].hits() > 0) {                             // parse -p column[:len|%buckets]
+  string spec = opt[CHR(OPT_PRT)].str();
+  auto found = spec.find_last_of(":%");
+  r.prt_column = spec.substr(0, found);
+  if(found != string::npos) {
+   size_t n = strtoul(spec.c_str() + found + 1, nullptr, 10);
+   (spec[found] == ':'? r.prt_len: r.prt_buckets) = n;
+  }
+  DBG(0) DOUT() << "partitioning by column: " << r.prt_column << ", prefix/buckets: "
+                << r.prt_len << '/' << r.prt_buckets << endl;
+ }
 }
 
 
@@ -472,43 +1101,508 @@ void parse_db(SharedResource &r) {
 
 
 void read_json(SharedResource &r) {
- // read and parse json from stdin
- REVEAL(r, json, DBG())
+ // read and parse json (or decode CBOR / MessagePack) from stdin
+ REVEAL(r, opt, json, DBG())
 
  DBG(0) DOUT() << "reading json from <stdin>" << endl;
- json.raw().parse( string{istream_iterator<char>(cin>>noskipws),
-                    istream_iterator<char>{}} );
+ string input{istream_iterator<char>(cin>>noskipws), istream_iterator<char>{}};
+ const string & fmt = opt[CHR(OPT_FMT)].str();
+ auto format = fmt == "cbor"? Jbin::cbor: fmt == "msgpack"? Jbin::msgpack:
+               fmt == "json"? Jbin::json: Jbin::detect(input, json.limits());
+ DBG(0) DOUT() << "input format: " << ENUMS(Jbin::Format, format) << endl;
+
+ json.raw();
+ Histogram::Timer parse;
+ switch(format) {
+  case Jbin::cbor: json.root() = Jbin::from_cbor(input, json.limits()); break;
+  case Jbin::msgpack: json.root() = Jbin::from_msgpack(input, json.limits()); break;
+  default:
+        if(opt[CHR(OPT_REJ)].hits() > 0) return read_records(r, input);
+        json.parse(input);
+ }
+ if(r.lat) (*r.lat)[LAT_PARSE].record(parse.elapsed());         // entire input is one sample
+}
+
+
+
+void read_join(SharedResource &r) {
+ // load join input (-j file:key) into a hash table: values of mapped fields (-J) by the key;
+ // the key and fields are labels of a record, or walk-paths relative to a record
+ REVEAL(r, opt, json, join, join_fields, join_columns, DBG())
+
+ const string & spec = opt[CHR(OPT_JIN)].str();
+ auto found = spec.find(':');
+ string file = spec.substr(0, found), key = spec.substr(found + 1);
+ ifstream in{file, ios::binary};
+ if(not in)
+  { cerr << "error: could not open join file: " << file << endl; exit(RC_NO_JOIN_FILE); }
+ string input{istreambuf_iterator<char>(in), istreambuf_iterator<char>{}};
+
+ DBG(0) DOUT() << "reading join input from " << file << ", key: " << key << endl;
+ Json records;
+ records.limits(json.limits()).parse_records(input, [&file](const Json::Reject &rej) {
+  cerr << "error: malformed record in join file " << file << " at offset " << rej.offset
+       << " (" << ENUMS(Jnode::ThrowReason, rej.reason) << ")" << endl;
+  exit(RC_ILL_JOIN);
+ });
+
+ set<string> walks;                                             // tell walk-paths from labels
+ Json probe{OBJ{}};
+ vector<string> paths{key};
+ paths.insert(paths.end(), join_fields.begin(), join_fields.end());
+ for(auto &path: paths)
+  try { probe.walk(path); walks.insert(path); }
+  catch(Json::stdException & e)
+   { if(e.code() < Jnode::walk_offset_missing_closure) throw e; }
+ auto lookup = [&walks](Json &rec, const string &path, function<void(const Jnode &)> found) {
+                if(walks.count(path) == 1) {
+                 auto it = rec.walk(path);
+                 if(it != rec.end()) found(*it);
+                }
+                else
+                 if(rec.is_object() and rec.count(path) == 1) found(*rec.find(path));
+               };
+
+ join_columns.resize(join_fields.size());
+ for(auto &jrec: records.root()) {
+  Json rec{std::move(jrec.value())};                            // records are consumed
+  string key_value;
+  bool keyed = false;
+  lookup(rec, key, [&](const Jnode &jn) { key_value = stringify(jn); keyed = true; });
+  if(not keyed)
+   { DBG(1) DOUT() << "join record w/o key skipped: " << rec << endl; continue; }
+  auto ins = join.emplace(move(key_value), vector<string>{});
+  if(not ins.second)
+   { DBG(1) DOUT() << "duplicate join key: " << ins.first->first << endl; continue; }
+
+  auto & values = ins.first->second;
+  for(size_t i = 0; i < join_fields.size(); ++i) {
+   values.push_back(stringify(NUL{}));                          // a missing field is null
+   lookup(rec, join_fields[i], [&](const Jnode &jn) {
+    values.back() = stringify(jn);
+    if(join_columns[i].empty())                                 // column definition (-a)
+     join_columns[i] = maybe_quote(generate_column_name(r, jn)) +
+                       (jn.is_number() or jn.is_bool()? " NUMERIC": " TEXT");
+   });
+  }
+ }
+
+ for(size_t i = 0; i < join_fields.size(); ++i)                 // fields never found in records
+  if(join_columns[i].empty())
+   join_columns[i] = maybe_quote(walks.count(join_fields[i]) == 1?
+                                 generate_column_name(r, NUL{}): join_fields[i]) + " TEXT";
+ r.out(2) << "join input: " << join.size() << " keys loaded from " << file << endl;
+}
+
+
+
+void read_records(SharedResource &r, const string &input) {
+ // parse input made of records (NDJSON, or a JSON array of records): malformed records
+ // are written into reject file; the run is aborted if rejects exceed -R: either the count
+ // (checked upon each reject), or the rate of all records (checked once all are read)
+ REVEAL(r, opt, json, DBG())
+
+ ofstream rej{opt[CHR(OPT_REJ)].str()};
+ if(not rej)
+  { cerr << "error: could not open reject file: " << opt[CHR(OPT_REJ)].str() << endl;
+    exit(RC_NO_REJ_FILE); }
+ const string & limit = opt[CHR(OPT_RLM)].str();
+ bool limited = opt[CHR(OPT_RLM)].hits() > 0, rate = limited and limit.back() == '%';
+ double max_rejects = limited? stod(limit): 0;
+
+ size_t rejects = 0;
+ auto exceeded = [&] {
+                  cerr << "error: rejected " << rejects << " record(s), exceeding limit "
+                       << limit << ", see " << opt[CHR(OPT_REJ)].str() << endl;
+                  exit(RC_REJ_LIMIT);
+                 };
+ Histogram::Timer parse;                                        // parse latency by records
+ json.parse_records(input, [&](const Json::Reject &rjt) {
+  rej << "# offset: " << rjt.offset << ", error at: " << rjt.error << " ("
+      << ENUMS(Jnode::ThrowReason, rjt.reason) << ")" << endl << rjt.record;
+  if(rjt.record.empty() or rjt.record.back() != '\n') rej << endl;
+  if(++rejects > max_rejects and limited and not rate) exceeded();
+  parse.reset();
+ }, [&](const Jnode &) {
+  if(r.lat) (*r.lat)[LAT_PARSE].record(parse.elapsed());
+  parse.reset();
+ });
+
+ size_t records = json.children() + rejects;
+ DBG(0) DOUT() << "read " << records << " records, rejected " << rejects << endl;
+ if(rate and rejects * 100. > max_rejects * records) exceeded();
+ if(rejects > 0)
+  r.out(3) << "rejected " << rejects << " of " << records << " records into "
+           << opt[CHR(OPT_REJ)].str() << endl;
 }
 
 
 
 void update_table(SharedResource &r) {
  // put callback on each mapped label and let callbacks do the job
- REVEAL(r, opt, opr, json, table_info, tbl_name, DBG())
+ REVEAL(r, opt, opr, json, table_info, DBG())
 
  Sqlite db;
  DBG().severity(db);
 
  Vstr_maps row(r);
- auto cb = [&r, &row, &db](const Jnode & node){ json_callback(r, db, row, node); };
+ Vstr_maps cschema(r);                                          // column definitions (-a)
+ auto cb = [&r, &row, &cschema, &db](const Jnode & node)
+            { json_callback(r, db, row, cschema, node); };
 
  size_t opt_cnt = 0;
  for(const auto &mapped_lbl: opr[CHR(OPT_MAP)])
   row.book(mapped_lbl, cb, ++opt_cnt);                          // create a holder for each label
+ cschema = row;                                                 // schema holder mirrors row's
 
  db.open(opt[ARG_DBF].str());
+ Deflate::register_functions(*db.dbp());                        // jsl_decompress() for triggers
+ if(opt[CHR(OPT_BAT)] > 0)                                      // batches are read via vtab
+  db.row_source(STR(ROW_SRC), r.batch);
  r.out(2) << "table [" << opt[ARG_TBL].str() << "]:" << endl;
  if(not table_info.empty()) {                                   // update tbl only if -a not given
-  db.begin_transaction()
-    .compile(opt[CHR(OPT_CLS)].str() + " INTO " +
-             tbl_name + columns(r) + " VALUES (" + value_placeholders(r) + ");");
+  compile_update(r, db);
   r.out(2) << "headers.. |";
   for(auto &info_row: table_info) r.out(2) << info_row.name << "|";
   r.out(2) << endl;
  }
 
  json.engage_callbacks().walk("<.^>R", Json::keep_cache);
+ if(not r.zip_pending.empty()) train_dictionaries(r, db);       // input is shorter than -Z
+ flush_batch(r, db);                                            // flush the last (partial) batch
+ if(r.unmatched > 0)
+  r.out(3) << "skipped " << r.unmatched << " rows w/o a match in join input" << endl;
+ close_partitions(r, db);
+ store_dictionaries(r, db);
+ if(opt[CHR(OPT_RET)].hits() > 0 and not table_info.empty())   // table may be not generated yet
+  r.purged += purge_rows(r, db, r.tbl_name);
+ Histogram::Timer commit;
  db.close();
+ if(r.lat) (*r.lat)[LAT_COMMIT].record(commit.elapsed());
+ if(opt[CHR(OPT_RET)].hits() > 0)
+  r.out(3) << "purged " << r.purged << " rows outside of retention window" << endl;
+ if(r.zip_in > 0)
+  r.out(3) << "compressed " << r.zip_in << " bytes into " << r.zip_out << endl;
+ close_targets(r);
+}
+
+
+
+void compile_update(SharedResource &r, Sqlite &db) {
+ // begin transaction and compile update statement: either with value placeholders, or
+ // selecting from the row source when batching (-b)
+ REVEAL(r, opt, tbl_name, table_info, ignored, batch, zip_columns)
+
+ string sql = opt[CHR(OPT_CLS)].str() + " INTO " + tbl_name + columns(r);
+ if(opt[CHR(OPT_BAT)] > 0) {
+  batch.columns = table_info.size() - ignored.size();
+  sql += " SELECT " + value_placeholders(r, true) + " FROM " STR(ROW_SRC) ";";
+ }
+ else
+  sql += " VALUES (" + value_placeholders(r) + ");";
+ db.begin_transaction().prepare(sql);                           // executed by rows or batches
+
+ set<string> zipped;                                            // locate compressed columns (-z)
+ size_t pos = 0;
+ for(auto &info: table_info)
+  if(ignored.count(info.name) == 0) {
+   if(zip_columns.count(info.name) == 1) { r.zip[pos] = nullptr; zipped.insert(info.name); }
+   ++pos;
+  }
+ for(auto &column: zip_columns)
+  if(zipped.count(column) == 0)
+   { cerr << "error: no compressed column " << column << " in update" << endl;
+     exit(RC_NO_ZIP_CLM); }
+ if(opt[CHR(OPT_ZDC)].hits() == 0)                              // no training: compress right away
+  for(auto &zip: r.zip) zip.second.reset(new Deflate);
+
+ if(r.targets.empty())                                          // open fan-out targets (-o)
+  for(const auto &spec: opt[CHR(OPT_OUT)])
+   r.targets.emplace_back(new Target(r, spec));
+}
+
+
+
+void flush_batch(SharedResource &r, Sqlite &db) {
+ // insert all batched rows by a single statement; if it fails (constraint violation) then
+ // retry row by row, so that only offending rows are dropped (as without batching)
+ REVEAL(r, batch, attempts, updates, DBG())
+
+ if(batch.rows.empty()) return;
+ batch.first = 0;
+ batch.last = SIZE_MAX;
+ Histogram::Timer insert;
+ if(db.execute().rc() AMONG(SQLITE_OK, SQLITE_DONE)) {
+  updates += batch.rows.size();
+  if(r.lat) (*r.lat)[LAT_INSERT].record(insert.elapsed());
+ }
+ else {
+  DBG(1) DOUT() << "batch failed (rc: " << db.rc() << "), retrying row by row" << endl;
+  for(batch.last = 1; batch.first < batch.rows.size(); ++batch.first, ++batch.last)
+   if(db.execute().rc() AMONG(SQLITE_OK, SQLITE_DONE))
+    ++updates;
+ }
+ attempts += batch.rows.size();
+ r.out(1) << "-- flushed batch to db (" << updates << " updates / "
+          << batch.rows.size() << " rows)" << endl;
+ batch.rows.clear();
+}
+
+
+
+string partition_key(SharedResource &r, const vector<string> &row) {
+ // build partition key from the partitioning column's value: entire value, its prefix, or
+ // hash bucket (FNV-1a, so that buckets are stable across runs and platforms)
+ REVEAL(r, table_info, ignored, prt_column, prt_len, prt_buckets)
+
+ size_t idx = 0;                                                // locate column's value in row
+ for(auto &info: table_info)
+  if(info.name == prt_column) break;
+  else if(ignored.count(info.name) == 0) ++idx;
+ if(idx >= row.size())
+  { cerr << "error: no partitioning column " << prt_column << " in update" << endl;
+    exit(RC_NO_PRT_CLM); }
+
+ string key = row[idx];
+ if(prt_len > 0 and key.size() > prt_len) key.resize(prt_len);
+ if(prt_buckets > 0) {
+  uint64_t h = 14695981039346656037ULL;
+  for(unsigned char c: row[idx]) { h ^= c; h *= 1099511628211ULL; }
+  key = to_string(h % prt_buckets);
+ }
+ return key;
+}
+
+
+
+string partition_suffix(string key) {
+ // key becomes part of a name (of a table, or a file): only letters and digits are kept
+ for(auto &c: key)
+  if(not isalnum(static_cast<unsigned char>(c))) c = '_';
+ return key;
+}
+
+
+
+void route_row(SharedResource &r, Sqlite &db, vector<string> &&row, const string *pkey) {
+ // write row into its partition, create partition if not yet; pkey is given when the row's
+ // key was taken before the row got compressed
+ REVEAL(r, partitions)
+
+ string key = pkey? *pkey: partition_key(r, row), suffix = partition_suffix(key);
+ auto & partition = partitions[suffix];
+ if(not partition)
+  partition.reset(new Partition(r, db, suffix, key));
+ else if(partition->key() != key) {                             // don't merge distinct keys
+  cerr << "error: partition keys '" << partition->key() << "' and '" << key
+       << "' clash in partition " << partition->name() << endl;
+  exit(RC_PRT_CLASH);
+ }
+ partition->write(move(row));
+ r.out(1) << "-- routed to partition " << partition->name() << endl;
+}
+
+
+
+void close_partitions(SharedResource &r, Sqlite &db) {
+ // close all partitions (collecting their stats), then update view over partitions (-v)
+ REVEAL(r, opt, partitions, attempts, updates)
+
+ for(auto &partition: partitions) {
+  partition.second->close();
+  attempts += partition.second->attempts();
+  updates += partition.second->updates();
+  r.purged += partition.second->purged();
+  merge_latencies(r, partition.second->latencies());
+ }
+ if(opt[CHR(OPT_VEW)].hits() > 0 and opt[CHR(OPT_PFL)].hits() == 0)
+  update_view(r, db);
+ partitions.clear();
+}
+
+
+
+void update_view(SharedResource &r, Sqlite &db) {
+ // (re)create view over recent (by key) partition tables: all in db, not just updated ones,
+ // i.e. also those of past runs - tables <table>_<key> with the table's columns and a key
+ // possible in the partitioning scheme; keys are ordered as numbers, if both are numeric
+ REVEAL(r, opt, tbl_name, schema, partitions, prt_buckets, DBG())
+
+ auto numeric = [](const string &key)
+                { return key.find_first_not_of("0123456789") == string::npos; };
+ auto later = [&numeric](const string &l, const string &r) {    // most recent first
+               if(not numeric(l) or not numeric(r)) return l > r;
+               auto lz = min(l.find_first_not_of('0'), l.size()),
+                    rz = min(r.find_first_not_of('0'), r.size());
+               if(l.size() - lz != r.size() - rz) return l.size() - lz > r.size() - rz;
+               return l.compare(lz, string::npos, r, rz, string::npos) > 0;
+              };
+ auto is_key = [&](const string &key) {                         // see partition_suffix()
+                if(key.empty()) return false;
+                for(unsigned char c: key) if(not isalnum(c) and c != '_') return false;
+                if(prt_buckets == 0) return true;
+                return numeric(key) and later(to_string(prt_buckets), key);
+               };
+
+ set<string, decltype(later)> keys(later);
+ for(auto &partition: partitions) keys.insert(partition.first);
+ vector<MasterRecord> master_tbl;
+ Sqlite{}.share(db)
+         .compile("SELECT * FROM sqlite_master WHERE type='table';")
+         .read(master_tbl);
+ string pfx = tbl_name + "_", columns = schema.substr(schema.find('('));
+ for(auto &rec: master_tbl)
+  if(rec.name.compare(0, pfx.size(), pfx) == 0 and is_key(rec.name.substr(pfx.size())) and
+     rec.sql.find('(') != string::npos and rec.sql.substr(rec.sql.find('(')) == columns)
+   keys.insert(rec.name.substr(pfx.size()));
+ vector<string> tables;
+ for(auto &key: keys)
+  if(tables.size() < opt[CHR(OPT_VEW)]) tables.push_back(pfx + key);
+ if(tables.empty()) return;
+
+ string view = tbl_name + STR(VIEW_SFX), sql;
+ for(auto &table: tables)
+  sql += (sql.empty()? "": " UNION ALL ") + ("SELECT * FROM " + maybe_quote(table));
+ DBG(1) DOUT() << "view " << view << ": " << sql << endl;
+ Sqlite{}.share(db).compile("DROP VIEW IF EXISTS " + maybe_quote(view) + ";");
+ Sqlite{}.share(db).compile("CREATE VIEW " + maybe_quote(view) + " AS " + sql + ";");
+ r.out(2) << "updated view " << view << " over " << tables.size() << " partitions" << endl;
+}
+
+
+
+const vector<string> & pragma_profile(const string &profile) {
+ // return pragmas for the given fan-out target's profile
+ static const map<string, vector<string>> profiles{
+  {"", {}},
+  {"fast", {"PRAGMA synchronous=OFF;", "PRAGMA journal_mode=MEMORY;"}},
+  {"wal", {"PRAGMA journal_mode=WAL;", "PRAGMA synchronous=NORMAL;"}},
+  {"safe", {"PRAGMA synchronous=FULL;"}}
+ };
+ auto found = profiles.find(profile);
+ if(found == profiles.end())
+  { cerr << "error: unknown profile: " << profile << endl; exit(RC_ILL_PROFILE); }
+ return found->second;
+}
+
+
+
+size_t purge_rows(SharedResource &r, Sqlite &db, const string &table) {
+ // delete rows outside of retention window (-t) within db's transaction: in batches by ranges
+ // of the retention column (over its index), thus each delete is bounded; return # purged
+ REVEAL(r, table_info, ret_column, ret_window, ret_batch, DBG())
+
+ auto info = find_if(table_info.begin(), table_info.end(),
+                     [&ret_column](const TableInfo &ti) { return ti.name == ret_column; });
+ if(info == table_info.end())
+  { cerr << "error: no retention column " << ret_column << " in table" << endl;
+    exit(RC_NO_RET_CLM); }
+ string type = info->type;                                      // tell the column's affinity
+ transform(type.begin(), type.end(), type.begin(), ::toupper);
+ auto has = [&type](const char *t) { return type.find(t) != string::npos; };
+ bool numeric = has("INT") or not (type.empty() or has("CHAR") or has("CLOB") or
+                                   has("TEXT") or has("BLOB"));
+
+ string column = maybe_quote(ret_column), tbl = maybe_quote(table), cutoff;
+ Sqlite{}.share(db).compile(numeric?                            // a statement per shared object
+                            "SELECT strftime('%s','now') - " + to_string(ret_window) + ";":
+                            "SELECT datetime('now','-" + to_string(ret_window) + " seconds');")
+                           >> cutoff;
+
+ int64_t indexed = 0;                                           // ensure column is indexed
+ Sqlite{}.share(db)
+         .compile("SELECT count(*) FROM pragma_index_list(?) AS l, pragma_index_info(l.name) "
+                  "AS i WHERE i.seqno = 0 AND i.name = ?;") << table << ret_column >> indexed;
+ if(indexed == 0) {
+  Sqlite{}.share(db).compile("CREATE INDEX IF NOT EXISTS " +
+                             maybe_quote(table + "_" + ret_column + "_idx") +
+                             " ON " + tbl + " (" + column + ");");
+  DBG(0) DOUT() << "created index on retention column " << ret_column << endl;
+ }
+
+ size_t purged = 0;
+ for(bool last = false; not last;) {                            // delete by ranges of the index
+  string bound;
+  Sqlite sel, del;
+  sel.share(db).compile("SELECT " + column + " FROM " + tbl + " WHERE " + column + " < ? ORDER BY "
+                        + column + " LIMIT 1 OFFSET " + to_string(ret_batch - 1) + ";")
+                       << cutoff >> bound;
+  last = sel.rc() != SQLITE_ROW;                                // less than a batch is left
+  del.share(db).compile("DELETE FROM " + tbl + " WHERE " + column + (last? " < ?;": " <= ?;"))
+                       << (last? cutoff: bound);
+  purged += del.changes();
+  DBG(1) DOUT() << "purged from " << table << " up to: " << (last? cutoff: bound)
+                << " (total " << purged << " rows)" << endl;
+ }
+ return purged;
+}
+
+
+
+void close_targets(SharedResource &r) {
+ // wait for fan-out targets to complete writing
+ REVEAL(r, targets)
+
+ for(auto &target: targets) {
+  target->close();
+  merge_latencies(r, target->latencies());
+  r.out(3) << "attempted " << target->attempts() << " updates, updated "
+           << target->updates() << " records into " << target->name() << endl;
+  if(target->purged() > 0)
+   r.out(3) << "purged " << target->purged() << " rows from " << target->name() << endl;
+ }
+ targets.clear();
+}
+
+
+
+void merge_latencies(SharedResource &r, const Latencies *lat) {
+ // merge latencies recorded by a writer (partition / fan-out target) into overall ones
+ if(not r.lat or lat == nullptr) return;
+ for(size_t i = 0; i < LAT_END; ++i)
+  (*r.lat)[i].merge((*lat)[i]);
+}
+
+
+
+void report_latencies(SharedResource &r) {
+ // print percentiles (in microseconds) of recorded stages (-L): as a table, or JSON
+ REVEAL(r, opt, lat)
+
+ static const char * stages[LAT_END]{"parse", "assemble", "insert", "queue", "commit"};
+ static const vector<double> pct{50, 90, 99, 99.9};
+ auto us = [](uint64_t ns) { return ns / 1000.; };
+
+ if(opt[CHR(OPT_LAT)].str() == "json") {
+  Json json{OBJ{}};
+  for(size_t i = 0; i < LAT_END; ++i) {
+   const Histogram & h = (*lat)[i];
+   if(h.count() == 0) continue;
+   Jnode stage{OBJ{ LBL{"count", NUM{double(h.count())}}, LBL{"min", NUM{us(h.min())}},
+                    LBL{"max", NUM{us(h.max())}}, LBL{"mean", NUM{h.mean() / 1000.}} }};
+   for(auto p: pct) {
+    stringstream ss;
+    ss << "p" << p;
+    stage[ss.str()] = NUM{us(h.percentile(p))};
+   }
+   json[stages[i]] = move(stage);
+  }
+  cout << json << endl;
+  return;
+ }
+
+ cout << "latency (us)" << right << setw(10) << "count" << setw(10) << "min";
+ for(auto p: pct) { stringstream ss; ss << "p" << p; cout << setw(10) << ss.str(); }
+ cout << setw(10) << "max" << setw(10) << "mean" << endl;
+ cout << fixed << setprecision(1);
+ for(size_t i = 0; i < LAT_END; ++i) {
+  const Histogram & h = (*lat)[i];
+  if(h.count() == 0) continue;
+  cout << left << setw(12) << stages[i] << right << setw(10) << h.count()
+       << setw(10) << us(h.min());
+  for(auto p: pct) cout << setw(10) << us(h.percentile(p));
+  cout << setw(10) << us(h.max()) << setw(10) << h.mean() / 1000. << endl;
+ }
 }
 
 
@@ -542,13 +1636,18 @@ string columns(SharedResource &r) {
 
 
 
-string value_placeholders(SharedResource &r) {
- // generate values placeholders (as many '?' as there updated parameters)
- REVEAL(r, table_info, ignored, DBG())
+string value_placeholders(SharedResource &r, bool row_source) {
+ // generate values placeholders (as many '?' as there updated parameters), or columns of
+ // the row source (-b); compressed values (-z) are cast to BLOBs
+ REVEAL(r, table_info, ignored, zip_columns, DBG())
 
  string str;
- for(size_t i=0; i<table_info.size() - ignored.size(); ++i)
-  str += "?,";
+ size_t i = 0;
+ for(auto &info: table_info)
+  if(ignored.count(info.name) == 0) {
+   string value = row_source? "c" + to_string(i++): "?";
+   str += (zip_columns.count(info.name) == 1? "CAST(" + value + " AS BLOB)": value) + ",";
+  }
 
  str.pop_back();
  DBG(0) DOUT() << "placeholders: " << str << endl;
@@ -570,11 +1669,11 @@ void update_row(SharedResource &r, Vstr_maps &row,
  if(node.is_atomic() or not expand) {                           // put a single value into a row
   row.push(node, stringify(node));                              // json iterables saved in row
   if(cschema == nullptr) return;                                // otherwise facilitate '-a' option
-  cschema->push(node, maybe_quote(generate_column_name(node)) + " " +
+  cschema->push(node, maybe_quote(generate_column_name(r, node, row.called_label())) + " " +
                       (node.is_number() or node.is_bool()? "NUMERIC": "TEXT") );
  }
  else {                                                         // it's iterable requiring expansion
-  string agg_column = generate_column_name(node);
+  string agg_column = generate_column_name(r, node, row.called_label());
   for(auto &rec: node) {
    row.push(node, stringify(rec));
    if(cschema == nullptr) continue;
@@ -590,7 +1689,19 @@ void update_row(SharedResource &r, Vstr_maps &row,
 
 void dump_row(SharedResource &r, Sqlite &db, Vstr_maps &row) {
  // dump row's data into the db
- REVEAL(r, opr, table_info, attempts, updates, DBG())
+ REVEAL(r, opr, table_info)
+
+ const vector<string> * joined = nullptr;                       // values from join input (-j)
+ if(r.join_key > 0) {
+  auto found = r.join.find(row.value_by_position(r.join_key)->front());
+  if(found == r.join.end()) {
+   r.out(1) << "-- no match in join input, skipped" << endl;
+   ++r.unmatched;
+   row.clear();
+   return;
+  }
+  joined = &found->second;
+ }
 
  vector<string> rout;                                           // prepare row for dumping to db
  for(size_t i=1; i<opr[CHR(OPT_MAP)].size(); ++i)
@@ -606,29 +1717,122 @@ void dump_row(SharedResource &r, Sqlite &db, Vstr_maps &row) {
    }
    r.out(1) << endl;
   }
+ if(joined != nullptr) {                                       // enrich row with joined values
+  r.out(1) << " joined";
+  for(auto &str: *joined) {
+   rout.push_back(str);
+   r.out(1) << (&str == &joined->front()? ": ": "|") << str;
+  }
+  r.out(1) << endl;
+ }
+ row.clear();
+ if(r.lat) (*r.lat)[LAT_ASSEMBLE].record(r.row_timer.elapsed());
+ if(r.zip.empty()) return emit_row(r, db, move(rout));
+ compress_row(r, db, move(rout));
+}
+
+
+
+void compress_row(SharedResource &r, Sqlite &db, vector<string> &&row) {
+ // compress values of columns (-z), unless dictionaries are being trained yet: then hold
+ // the row (as a sample) until given number of rows (-Z) is collected
+ REVEAL(r, opt, zip, zip_pending, zip_in, zip_out)
+
+ if(zip.begin()->second == nullptr) {
+  zip_pending.push_back( move(row) );
+  r.out(1) << "-- held for training (" << zip_pending.size() << " rows)" << endl;
+  if(zip_pending.size() >= opt[CHR(OPT_ZDC)]) train_dictionaries(r, db);
+  return;
+ }
+ string key;                                                    // partition by plain values
+ if(opt[CHR(OPT_PRT)].hits() > 0) key = partition_key(r, row);
+ for(auto &z: zip) {
+  zip_in += row[z.first].size();
+  row[z.first] = z.second->compress(row[z.first]);
+  zip_out += row[z.first].size();
+ }
+ emit_row(r, db, move(row), opt[CHR(OPT_PRT)].hits() > 0? &key: nullptr);
+}
+
+
+
+void train_dictionaries(SharedResource &r, Sqlite &db) {
+ // train a dictionary per compressed column (-Z) from held rows, then emit them
+ REVEAL(r, zip, zip_pending, DBG())
+
+ for(auto &z: zip) {
+  vector<string> samples;
+  for(auto &row: zip_pending) samples.push_back(row[z.first]);
+  z.second.reset(new Deflate{Deflate::train(samples)});
+  DBG(0) DOUT() << "trained dictionary " << z.second->id() << " for value " << z.first
+                << " (" << z.second->dictionary().size() << " bytes)" << endl;
+ }
+ r.out(2) << "trained dictionaries on " << zip_pending.size() << " rows" << endl;
+ deque<vector<string>> rows;
+ rows.swap(zip_pending);
+ for(auto &row: rows) compress_row(r, db, move(row));
+}
+
+
+
+void store_dictionaries(SharedResource &r, Sqlite &db) {
+ // store trained dictionaries into db's table DFL_DICT_TBL (read by jsl_decompress())
+ REVEAL(r, zip)
+
+ bool created = false;
+ for(auto &z: zip) {
+  if(z.second == nullptr or z.second->id() == 0) continue;      // no dictionary
+  if(not created)
+   Sqlite{}.share(db).compile("CREATE TABLE IF NOT EXISTS " DFL_DICT_TBL
+                              " (id INTEGER PRIMARY KEY, dict BLOB);");
+  created = true;
+  Sqlite{}.share(db).compile("INSERT OR IGNORE INTO " DFL_DICT_TBL
+                             " VALUES (?, CAST(? AS BLOB));")
+                    << static_cast<int64_t>(z.second->id()) << z.second->dictionary();
+ }
+}
+
+
+
+void emit_row(SharedResource &r, Sqlite &db, vector<string> &&rout, const string *key) {
+ // write row into targets (-o) and then into either a partition (-p), batch (-b), or db
+ REVEAL(r, attempts, updates, DBG())
+
+ for(auto &target: r.targets)                                   // fan out row (-o)
+  target->write( vector<string>(rout) );
+ if(r.opt[CHR(OPT_PRT)].hits() > 0)                             // partitioning rows (-p)
+  return route_row(r, db, move(rout), key);
+ if(r.opt[CHR(OPT_BAT)] > 0) {                                  // batching rows (-b)
+  r.batch.rows.push_back( move(rout) );
+  r.out(1) << "-- batched (" << r.batch.rows.size() << " rows)" << endl;
+  if(r.batch.rows.size() >= r.opt[CHR(OPT_BAT)]) flush_batch(r, db);
+  return;
+ }
+ Histogram::Timer insert;
  db << rout;
+ if(r.lat) (*r.lat)[LAT_INSERT].record(insert.elapsed());
  ++attempts;
  if(db.rc() AMONG(SQLITE_OK, SQLITE_DONE))
   ++updates;
- r.out(1) << "-- flushed to db (" << updates << " updates / " << row.size() << " values)" << endl;
- row.clear();
+ r.out(1) << "-- flushed to db (" << updates << " updates / " << rout.size() << " values)" << endl;
  DBG(2) DOUT() << "-- dumped to db " << updates << " records" << endl;
 }
 
 
 
-void json_callback(SharedResource &r, Sqlite &db, Vstr_maps &row, const Jnode & node) {
+void json_callback(SharedResource &r, Sqlite &db, Vstr_maps &row, Vstr_maps &cschema,
+                   const Jnode & node) {
  // build a row and dump it into database (also, facilitate -a option)
- REVEAL(r, opr, table_info, ignored, DBG())
+ REVEAL(r, table_info, ignored, DBG())
 
  DBG(2) DOUT() << (node.has_index()? "[" + to_string(node.index()) + "]":
                    (node.has_label()? node.label(): "root")) << ": " << node << endl;
  if(table_info.empty())                                         // need to generate schema (-a case)
-  if(not schema_generated(r, db, row, node)) return;            // schema is't yet ready
+  if(not schema_generated(r, db, row, cschema, node)) return;   // schema is't yet ready
 
- size_t full_size = table_info.size() - ignored.size();
+ size_t full_size = table_info.size() - ignored.size() - r.join_fields.size();
  if(row.size() > full_size) {                                   // if failed previously
-  if( (row.mapped_type(1) == Vstr_maps::label and node.label() != opr[CHR(OPT_MAP)].str(1))
+  if( (row.mapped_type(1) == Vstr_maps::label and row.called_label() != row.label_by_position(1))
        or
       (row.mapped_type(1) == Vstr_maps::iter and &node != &*r.json.itr_callbacks()[0].iter) )
    { DBG(1) DOUT() << "waiting for the first mapped value to come" << endl; return; }
@@ -636,6 +1840,7 @@ void json_callback(SharedResource &r, Sqlite &db, Vstr_maps &row, const Jnode &
   row.clear();                                                  // clean up the slate and start over
  }
 
+ if(r.lat and row.size() == 0) r.row_timer.reset();              // row's first value
  update_row(r, row, node);                                      // update row with given JSON node
 
  if(row.size() < full_size) return;                             // row is incomplete yet
@@ -649,12 +1854,13 @@ void json_callback(SharedResource &r, Sqlite &db, Vstr_maps &row, const Jnode &
 
 
 
-bool schema_generated(SharedResource &r, Sqlite &db, Vstr_maps &row, const Jnode & node) {
+bool schema_generated(SharedResource &r, Sqlite &db, Vstr_maps &row, Vstr_maps &cschema,
+                      const Jnode & node) {
  // return true if schema was generated, table_info read, etc
  REVEAL(r, opt, opr, ignored, DBG());
- static Vstr_maps cschema{row};                                 // static ok, given build only once
 
  if(row.value_by_node(node).empty()) {                          // otherwise it's for a next row
+  if(r.lat and row.size() == 0) r.row_timer.reset();
   update_row(r, row, node, &cschema);                           // update and build column's schema
   if(DBG()(1))
    for(const auto &type: cschema.value_by_node(node))
@@ -672,6 +1878,8 @@ bool schema_generated(SharedResource &r, Sqlite &db, Vstr_maps &row, const Jnode
  for(size_t i = 1; i < opr[CHR(OPT_MAP)].size(); ++i)
   for(auto &column_def: *cschema.value_by_position(i))
    { schema += column_def + (primary_key? " PRIMARY KEY": "") + ","; primary_key = false; }
+ for(auto &column_def: r.join_columns)                          // joined columns (-j)
+  schema += column_def + ",";
  schema.pop_back();                                             // pop trailing ','
  schema += ");";
  DBG(1) DOUT() << "schema: " << schema << endl;
@@ -679,9 +1887,7 @@ bool schema_generated(SharedResource &r, Sqlite &db, Vstr_maps &row, const Jnode
  db.compile(schema);
  r.out(2) << "generated schema.. " << schema << endl;
  parse_db(r);                                                   // populate now table_info PRAGMA
- db.begin_transaction()
-   .compile(opt[CHR(OPT_CLS)].str() + " INTO " +
-             opt[ARG_TBL].str() + columns(r) + " VALUES (" + value_placeholders(r) + ");");
+ compile_update(r, db);
  dump_row(r, db, row);
  return true;
 }
@@ -725,14 +1931,19 @@ string & trim_spaces(std::string &&str) {
 }
 
 
-string generate_column_name(const Jnode &jn) {
- // autogenerate column name for array, for node with labels return labels
+string generate_column_name(SharedResource &r, const Jnode &jn, const string &spec) {
+ // autogenerate column name for array, for node with labels return labels, unless mapped
+ // by a scoped label spec: then it's the spec, e.g. shipping/city -> shipping_city
+ if(jn.has_label() and spec.size() > jn.label().size()) {
+  string name = spec;
+  for(auto &c: name) if(c == '/' or c == '@') c = '_';
+  return name;
+ }
  if(jn.has_label())
   return jn.label();
 
- static size_t col_num;                                         // sequenced column number
  std::stringstream ss;
- ss << STR(CLM_PFX) << std::hex << std::setfill('0') << std::setw(ROW_LMT * 2) << col_num++;
+ ss << STR(CLM_PFX) << std::hex << std::setfill('0') << std::setw(ROW_LMT * 2) << r.col_num++;
  return ss.str();
 }
 
@@ -0,0 +1,24 @@
+#include <sqlite3ext.h>
+SQLITE_EXTENSION_INIT1
+#include "lib/Deflate.hpp"
+
+/*
+c++ -o jsl_ext.so -Wall -std=gnu++14 -O3 -shared -fPIC jsl_ext.cpp -lz
+
+sqlite extension providing jsl's SQL functions to other readers of jsl made dbs, i.e.
+jsl_decompress() of columns compressed by jsl (option -z), e.g., in sqlite3 shell:
+
+sqlite> .load ./jsl_ext
+sqlite> SELECT jsl_decompress(payload) FROM events;
+*/
+
+
+
+extern "C"
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int sqlite3_extension_init(sqlite3 *db, char **, const sqlite3_api_routines *api) {
+ SQLITE_EXTENSION_INIT2(api);
+ return Deflate::register_functions(db);
+}
@@ -23,6 +23,10 @@
  *     - that includes recurrent data structures and those with (recursive) pointers
  *  4. data held by (dynamic) pointers is handled through user's callbacks
  *
+ * Contiguous data of fundamental types (strings, vectors of fundamentals/enums, native
+ * arrays) is serialized/deserialized in bulk (a single memcpy), the serialized image
+ * remains the same as if it was processed element by element
+ *
  * Blob class features 2 constructors (in addition to default's):
  *  - Constructor with data structures to be serialized:
  *
@@ -43,6 +47,7 @@
  *      reset()         // reset blob's state: requires in between append and restore
  *      clear()         // clears blob entirely
  *      offset()        // returns current offset (after next append/restore operations)
+ *      encoding()      // get/set encoding of serialized data (see below)
  *      size()          // returns size of the blob itself (not size of the Blob object)
  *      empty()         // check if blob is empty (e.g. after clear())
  *      data()          // returns blob's data (string of serialized bytes)
@@ -158,17 +163,62 @@
  *      std::ifstream bf(file, std::ios::binary);
  *      bf >> std::noskipws >> b;
  *
+ * Compact encoding:
+ *
+ * by default (Blob::native encoding) data are serialized as their memory images, e.g.
+ * each int takes 4 bytes. Blobs of mostly small integral values could be made much more
+ * compact (opt-in), then integral values (and enums) wider than a byte as well as
+ * container counters are serialized as LEB128 varints (signed values - zigzag'ed):
+ *
+ *      Blob b;
+ *      b.encoding(Blob::compact).append(x, y, z);
+ *
+ * Blob::delta encoding in addition writes sorted sequences of integral values (vector,
+ * list, deque) as deltas between successive values. The encoding is not recorded in the
+ * blob, thus the blob must be restored with the same encoding it was serialized with:
+ *
+ *      Blob r(...);                        // e.g. read from a file
+ *      r.encoding(Blob::compact);
+ *      SomeClass x(r);
+ *
+ * in compact encodings vectors/arrays of integral values are no longer copied in bulk
+ *
+ * BlobView is a non-owning (restore-only) Blob: it de-serializes directly from
+ * memory-mapped files or any borrowed memory w/o copying it:
+ *
+ *      BlobView bv(file);                  // memory-map the file
+ *      SomeClass x(bv);
+ *
+ * BlobSink and BlobSource stream serialized data to/from a file (descriptor) through a
+ * fixed-size buffer, thus the entire serialized image is never held in memory:
+ *
+ *      { BlobSink bs(file);                // or BlobSink bs(fd, buffer_size);
+ *        bs.append(x, y, z); }             // flushed when bs is destroyed (or by flush())
+ *
+ *  - size() and data() of a sink cover only the buffered (not yet flushed) part,
+ *    flushed() tells how many bytes are written out already
+ *
+ *      BlobSource src(file);               // read and restore incrementally
+ *      SomeClass x(src);
  *
- * for more usage examples see "gt_blob.cpp"
+ *
+ * for more usage examples see "gt_blob.cpp", for throughput figures - "bm_blob.cpp"
  *
  */
 
 #pragma once
 
 #include <vector>
+#include <algorithm>    // std::is_sorted
 #include <utility>      // std::forward, std::move,
 #include <cstdint>      // uint8_t, ...
+#include <cstring>      // memcpy
 #include <type_traits>
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // fstat
+#include <fcntl.h>      // open
+#include <unistd.h>     // close, read, write, lseek
+#include <cerrno>
 #include "extensions.hpp"
 
 
@@ -200,6 +250,23 @@
 
 
 class Blob{
+  // flat data: fundamentals and enums, i.e. whatever is serialized as a plain memory
+  // image - contiguous sequences of such data are copied in bulk (memcpy)
+  template<typename T>
+  struct is_flat_: std::integral_constant<bool, std::is_fundamental<T>::value or
+                                                std::is_enum<T>::value> {};
+  // integral data subject to compact encoding (single bytes and bools stay as they are)
+  template<typename T>
+  struct is_compact_: std::integral_constant<bool, (std::is_integral<T>::value or
+                                                    std::is_enum<T>::value) and
+                                                   not std::is_same<T, bool>::value and
+                                                   (sizeof(T) > 1)> {};
+  // integer type underlying an integral or enum type
+  template<typename T, bool = std::is_enum<T>::value>
+  struct int_of_ { typedef T type; };
+  template<typename T>
+  struct int_of_<T, true> { typedef typename std::underlying_type<T>::type type; };
+
   // dump blob into output stream
   friend std::ostream & operator<<(std::ostream &os, const Blob & self) {
                          os.write(reinterpret_cast<const char*>(self.data()), self.size());
@@ -222,11 +289,26 @@ class Blob{
 
     #define THROWREASON \
                 inconsistent_data_while_appending, \
-                inconsistent_data_while_restoring
+                inconsistent_data_while_restoring, \
+                could_not_map_file, \
+                could_not_open_file, \
+                could_not_write_file, \
+                could_not_read_file
     ENUMSTR(ThrowReason, THROWREASON)
 
+    #define ENCODING \
+                native, \
+                compact, \
+                delta
+    ENUMSTR(Encoding, ENCODING)
+
 
                         Blob(void) = default;                   // DC
+                        Blob(const Blob & b) { *this = b; }     // CC: a view is copied as data
+                        Blob(Blob && b) { *this = std::move(b); }       // MC
+    virtual            ~Blob(void) = default;                   // streaming blobs derive
+    Blob &              operator=(const Blob & b);
+    Blob &              operator=(Blob && b);
 
                         // constructors to dump target data into blob:
                         // Blob(src1, src2, ...);
@@ -238,7 +320,7 @@ class Blob{
                         // handy to use with istream_iterator's:
     template<class Iter>
                         Blob(Iter first, Iter last)
-                         { while(first != last) store().push_back(*first++); }
+                         { store().assign(first, last); }       // bulk copy for random access
 
 
     // User interface to work with Blob:
@@ -247,12 +329,16 @@ class Blob{
     Blob &              reset(void)
                          { /*vp_.clear(); mpu_.clear(); mpl_.clear();*/ offset_=0; return *this; }
     Blob &              clear(void) { blob_.clear(); return reset(); }
-    size_t              offset(void) const { return offset_; }
-    size_t              size(void) const { return blob_.size(); }
-    bool                empty(void) const { return blob_.empty(); }
+    size_t              offset(void) const { return base_ + offset_; }
+    Blob &              encoding(Encoding e) { enc_ = e; return *this; }
+    Encoding            encoding(void) const { return enc_; }
+    virtual size_t      size(void) const { return blob_.size(); }
+    bool                empty(void) const { return size() == 0; }
 
+                        // non-const data()/store() give access to own (writable) storage
     uint8_t *           data(void) { return blob_.data(); }
-    const uint8_t *     data(void) const { return blob_.data(); }
+    virtual const uint8_t *
+                        data(void) const { return blob_.data(); }
  std::vector<uint8_t> & store(void) { return blob_; }
     const std::vector<uint8_t> &
                         store(void) const { return blob_; }
@@ -275,9 +361,12 @@ class Blob{
     //
     // ... APPEND [to the blob] methods
     //
-                        // generic, data-type agnostic append
-    void                append_raw(const void *ptr, size_t s)
-                         { for(size_t i = 0; i < s; ++i) blob_.push_back(((uint8_t*)ptr)[i]); }
+                        // generic, data-type agnostic append (single reserve + memcpy)
+    void                append_raw(const void *ptr, size_t s) {
+                         if(s > limit_ - blob_.size()) return spill_(ptr, s);
+                         auto bp = static_cast<const uint8_t*>(ptr);
+                         blob_.insert(blob_.end(), bp, bp + s);
+                        }
 
                         // 0. variadic append
     template<typename T, typename... Args>
@@ -287,7 +376,7 @@ class Blob{
                         // 1a. atomic (fundamental) type append
     template<typename T>
     typename std::enable_if<std::is_fundamental<T>::value, const T &>::type
-                        append(const T & v) { append_raw(&v, sizeof(T)); return v; }
+                        append(const T & v) { appendAtom_(v, is_compact_<T>{}); return v; }
 
                         // 1b. SERDES class append (custom class must provide serialize(Blob &))
     template<typename T>
@@ -298,28 +387,57 @@ class Blob{
                         // 1c. atomic (enum) type append
     template<typename T>
     typename std::enable_if<std::is_enum<T>::value, const T &>::type
-                        append(const T & v) { append_raw(&v, sizeof(T)); return v; }
+                        append(const T & v) { appendAtom_(v, is_compact_<T>{}); return v; }
 
                         // 2. containers
                         // 2a. basic string append
     const std::basic_string<char> &
                         append(const std::basic_string<char> & c)
-                         { appendCntr_(c.size()); for(char v: c) append(v); return c; }
+                         { appendCntr_(c.size()); append_raw(c.data(), c.size()); return c; }
 
-                        // 2b. native arrays append
+                        // 2b. native arrays append (arrays of flat data are copied in bulk)
     template<typename T>
-    typename std::enable_if<std::is_array<T>::value, const T &>::type
+    typename std::enable_if<std::is_array<T>::value and
+                            not is_flat_<typename std::remove_all_extents<T>::type>::value,
+                            const T &>::type
                         append(const T & v) {
                          for(int i=0, s=sizeof(v)/sizeof(v[0]); i<s; ++i) append(v[i]);
                          return v;
                         }
 
+    template<typename T>
+    typename std::enable_if<std::is_array<T>::value and
+                            is_flat_<typename std::remove_all_extents<T>::type>::value,
+                            const T &>::type
+                        append(const T & v) {
+                         typedef typename std::remove_all_extents<T>::type E;
+                         if(enc_ == native or not is_compact_<E>::value)
+                          append_raw(&v, sizeof(v));
+                         else
+                          for(size_t i = 0; i < sizeof(v) / sizeof(E); ++i)
+                           append(reinterpret_cast<const E*>(&v)[i]);
+                         return v;
+                        }
+
                         // 2c. trivial containers - single data allocator append
     template<template<typename, typename> class Container, typename T, typename Alloc>
     typename std::enable_if<std::is_member_function_pointer<decltype(& Alloc::allocate)>::value,
                             const Container<T, Alloc> &>::type
                         append(const Container<T, Alloc> & c)
-                         { appendCntr_(c.size()); for(const T &v: c) append(v); return c; }
+                         { appendSeq_(c, is_compact_<T>{}); return c; }
+
+                        // 2c'. vector of flat data (contiguous storage) - bulk append
+                        // (vector<bool> is not contiguous, hence excluded)
+    template<typename T, typename Alloc>
+    typename std::enable_if<is_flat_<T>::value and not std::is_same<T, bool>::value,
+                            const std::vector<T, Alloc> &>::type
+                        append(const std::vector<T, Alloc> & c) {
+                         if(enc_ != native and is_compact_<T>::value)
+                          { appendSeq_(c, is_compact_<T>{}); return c; }
+                         appendCntr_(c.size());
+                         append_raw(c.data(), c.size() * sizeof(T));
+                         return c;
+                        }
 
                         // 2d. complex container append: map
     template<template<typename, typename, typename, typename> class Map,
@@ -345,10 +463,12 @@ class Blob{
     //
     // ... RESTORE [from the blob] methods
     //
-                        // generic, data-type agnostic restore
-    void                restore_raw(char * ptr, size_t s) {
-                         for(size_t i = 0; i < s; ++i)
-                          *static_cast<char*>(ptr++) = blob_.at(offset_++);
+                        // generic, data-type agnostic restore (single bounds check + memcpy)
+    void                restore_raw(void * ptr, size_t s) {
+                         if(s > rsize_() - offset_) return refill_(ptr, s);
+                         if(s == 0) return;
+                         memcpy(ptr, rdata_() + offset_, s);
+                         offset_ += s;
                         }
 
                         // 0. variadic restore
@@ -359,11 +479,7 @@ class Blob{
                         // 1a. atomic (fundamental) restore
     template<typename T>
     typename std::enable_if<std::is_fundamental<T>::value, T &>::type
-                        restore(T &r) {
-                         r = *reinterpret_cast<T*>(&blob_.at(offset_));
-                         offset_ += sizeof(T);
-                         return r;
-                        }
+                        restore(T &r) { restoreAtom_(r, is_compact_<T>{}); return r; }
 
                         // 1b. SERDES class restore (custom class must provide deserialize(Blob &))
     template<typename T>
@@ -374,33 +490,66 @@ class Blob{
                         // 1c. atomic (enum) restore
     template<typename T>
     typename std::enable_if<std::is_enum<T>::value, T &>::type
-                        restore(T &r) {
-                         r = *reinterpret_cast<T*>(&blob_.at(offset_));
-                         offset_ += sizeof(T);
-                         return r;
-                        }
+                        restore(T &r) { restoreAtom_(r, is_compact_<T>{}); return r; }
 
                         // 2. containers
                         // 2a. basic string restore
     std::basic_string<char> &
-                        restore(std::basic_string<char> & c)
-                         { c.resize(restoreCntr_()); for(auto &v: c) restore(v); return c; }
+                        restore(std::basic_string<char> & c) {
+                         size_t s = restoreCntr_();
+                         if(s > left_())                                // validate before resize
+                          throw EXP(inconsistent_data_while_restoring);
+                         c.resize(s);
+                         restore_raw(&c[0], s);
+                         return c;
+                        }
 
-                        // 2b. native arrays restore
+                        // 2b. native arrays restore (arrays of flat data are copied in bulk)
     template<typename T>
-    typename std::enable_if<std::is_array<T>::value, T &>::type
+    typename std::enable_if<std::is_array<T>::value and
+                            not is_flat_<typename std::remove_all_extents<T>::type>::value,
+                            T &>::type
                         restore(T &r) {
                          for(int i=0, s=sizeof(r)/sizeof(r[0]); i<s; ++i)
                           restore(r[i]);
                          return r;
                         }
 
+    template<typename T>
+    typename std::enable_if<std::is_array<T>::value and
+                            is_flat_<typename std::remove_all_extents<T>::type>::value,
+                            T &>::type
+                        restore(T &r) {
+                         typedef typename std::remove_all_extents<T>::type E;
+                         if(enc_ == native or not is_compact_<E>::value)
+                          restore_raw(&r, sizeof(r));
+                         else
+                          for(size_t i = 0; i < sizeof(r) / sizeof(E); ++i)
+                           restore(reinterpret_cast<E*>(&r)[i]);
+                         return r;
+                        }
+
                         // 2c. trivial container restore: vector/list/dequeue/array
     template<template<typename, typename> class Container, typename Alloc, typename T>
     typename std::enable_if<std::is_member_function_pointer<decltype(& Alloc::allocate)>::value,
                             Container<T, Alloc> &>::type
                         restore(Container<T, Alloc> & c)
-                         { c.resize(restoreCntr_()); for(auto &v: c) restore(v); return c; }
+                         { restoreSeq_(c, is_compact_<T>{}); return c; }
+
+                        // 2c'. vector of flat data (contiguous storage) - bulk restore
+    template<typename T, typename Alloc>
+    typename std::enable_if<is_flat_<T>::value and not std::is_same<T, bool>::value,
+                            std::vector<T, Alloc> &>::type
+                        restore(std::vector<T, Alloc> & c) {
+                         if(enc_ != native and is_compact_<T>::value)
+                          { restoreSeq_(c, is_compact_<T>{}); return c; }
+                         size_t s = restoreCntr_();
+                         if(s > left_() / sizeof(T))                    // validate before resize
+                          throw EXP(inconsistent_data_while_restoring);
+                         c.resize(s);
+                         restore_raw(c.data(), s * sizeof(T));
+                         return c;
+                        }
 
                         // 2d. complex container restore: map
     template<template<typename, typename, typename, typename> class Map,
@@ -425,7 +574,26 @@ class Blob{
 
  protected:
     size_t              offset_{0};
+    Encoding            enc_{native};                           // encoding of serialized data
    std::vector<uint8_t> blob_;
+    const uint8_t *     view_{nullptr};                         // borrowed data (see BlobView)
+    size_t              vsize_{0};                              // size of borrowed data
+
+    size_t              base_{0};                               // streamed bytes before blob_
+    size_t              pending_{0};                            // streamed bytes after blob_
+    size_t              limit_{SIZE_MAX};                       // blob_ size which spills it
+
+                        // source of restore operations: borrowed data if any, otherwise own
+    const uint8_t *     rdata_(void) const { return view_ != nullptr? view_: blob_.data(); }
+    size_t              rsize_(void) const { return view_ != nullptr? vsize_: blob_.size(); }
+    size_t              left_(void) const { return rsize_() - offset_ + pending_; }
+
+                        // streaming blobs: called when append would exceed limit_, or
+                        // when restore runs out of data; plain Blob neither spills nor refills
+    virtual void        spill_(const void *, size_t)
+                         { throw EXP(inconsistent_data_while_appending); }
+    virtual void        refill_(void *, size_t)
+                         { throw EXP(inconsistent_data_while_restoring); }
 
  private:
 std::vector<const void*>cptr_;                                  // host pointers for append.
@@ -435,8 +603,9 @@ std::vector<const void*>cptr_;                                  // host pointers
     // size to bits-space of the counter itself - it will break then either of
     // endianess.
     // any further optimization of serialized space must be done with compression
-    // algorithms
+    // algorithms (or compact encoding, where counters are varints)
     void                appendCntr_(size_t s) {
+                         if(enc_ != native) { appendVarint_(s); return; }
                          uint8_t cs = counterSize_(s);
                          append(cs);
                          switch(cs) {
@@ -448,6 +617,7 @@ std::vector<const void*>cptr_;                                  // host pointers
                          }
                         }
     size_t              restoreCntr_(void) {
+                         if(enc_ != native) return restoreVarint_();
                          uint8_t cs;
                          restore(cs);
                          switch(cs) {
@@ -471,24 +641,409 @@ std::vector<const void*>cptr_;                                  // host pointers
                          return 0;
                         }
 
+    // compact encoding: integral values (and enums) are written as LEB128 varints,
+    // signed ones are zigzag'ed first (so that small negatives remain short).
+    // with delta encoding, sorted (non-descending) sequences of integral values are
+    // written as the first value followed by varints of differences (a leading flag
+    // byte tells if the sequence is delta-encoded)
+    void                appendVarint_(uint64_t v) {
+                         uint8_t buf[10];
+                         size_t n = 0;
+                         for(; v >= 0x80; v >>= 7) buf[n++] = static_cast<uint8_t>(v | 0x80);
+                         buf[n++] = static_cast<uint8_t>(v);
+                         append_raw(buf, n);
+                        }
+    uint64_t            restoreVarint_(void) {
+                         uint64_t v = 0;
+                         for(int shift = 0; shift < 64; shift += 7) {
+                          uint8_t b;
+                          restore_raw(&b, 1);
+                          if(shift == 63 and b > 1)                     // bits beyond 64th
+                           throw EXP(inconsistent_data_while_restoring);
+                          v |= static_cast<uint64_t>(b & 0x7F) << shift;
+                          if((b & 0x80) == 0) return v;
+                         }
+                         throw EXP(inconsistent_data_while_restoring);  // overlong varint
+                        }
+
+    template<typename T>
+    static uint64_t     widen_(T v) {                           // sign-extend to 64 bits
+                         typedef typename int_of_<T>::type I;
+                         return static_cast<uint64_t>(static_cast<I>(v));
+                        }
+    template<typename T>
+    T                   narrow_(uint64_t v) {                   // reverse of widen_(), checked
+                         auto i = static_cast<typename int_of_<T>::type>(v);
+                         if(static_cast<uint64_t>(i) != v)
+                          throw EXP(inconsistent_data_while_restoring);
+                         return static_cast<T>(i);
+                        }
+    template<typename T>
+    static uint64_t     zigzag_(T v) {
+                         uint64_t w = widen_(v);
+                         if(not std::is_signed<typename int_of_<T>::type>::value) return w;
+                         return (w << 1) ^ (0 - (w >> 63));
+                        }
+    template<typename T>
+    T                   unzigzag_(uint64_t v) {
+                         if(std::is_signed<typename int_of_<T>::type>::value)
+                          v = (v >> 1) ^ (0 - (v & 1));
+                         return narrow_<T>(v);
+                        }
+
+    template<typename T>
+    void                appendAtom_(const T & v, std::false_type)
+                         { append_raw(&v, sizeof(T)); }
+    template<typename T>
+    void                appendAtom_(const T & v, std::true_type)
+                         { if(enc_ == native) append_raw(&v, sizeof(T));
+                           else appendVarint_(zigzag_(v)); }
+    template<typename T>
+    void                restoreAtom_(T & r, std::false_type)
+                         { restore_raw(&r, sizeof(T)); }
+    template<typename T>
+    void                restoreAtom_(T & r, std::true_type)
+                         { if(enc_ == native) restore_raw(&r, sizeof(T));
+                           else r = unzigzag_<T>(restoreVarint_()); }
+
+                        // sequences (trivial containers) element-wise
+    template<typename C>
+    void                appendSeq_(const C & c, std::false_type)
+                         { appendCntr_(c.size()); for(auto &v: c) append(v); }
+    template<typename C>
+    void                appendSeq_(const C & c, std::true_type) {
+                         appendCntr_(c.size());
+                         if(enc_ != delta) { for(auto &v: c) append(v); return; }
+                         bool sorted = std::is_sorted(c.begin(), c.end());
+                         append(static_cast<uint8_t>(sorted));
+                         if(not sorted) { for(auto &v: c) append(v); return; }
+                         auto it = c.begin();
+                         if(it == c.end()) return;
+                         uint64_t prev = widen_(*it);
+                         append(*it);
+                         for(++it; it != c.end(); ++it)
+                          { appendVarint_(widen_(*it) - prev); prev = widen_(*it); }
+                        }
+    template<typename C>
+    void                restoreSeq_(C & c, std::false_type)
+                         { c.resize(restoreCntr_()); for(auto &v: c) restore(v); }
+    template<typename C>
+    void                restoreSeq_(C & c, std::true_type) {
+                         size_t s = restoreCntr_();
+                         if(enc_ != native and s > left_())             // at least a byte each
+                          throw EXP(inconsistent_data_while_restoring);
+                         c.resize(s);
+                         uint8_t sorted = 0;
+                         if(enc_ == delta and restore(sorted) > 1)
+                          throw EXP(inconsistent_data_while_restoring);
+                         if(not sorted) { for(auto &v: c) restore(v); return; }
+                         auto it = c.begin();
+                         if(it == c.end()) return;
+                         uint64_t prev = widen_(restore(*it));
+                         for(++it; it != c.end(); ++it)
+                          { prev += restoreVarint_(); *it = narrow_<typename C::value_type>(prev); }
+                        }
+
 };
 
 STRINGIFY(Blob::ThrowReason, THROWREASON)
 #undef THROWREASON
 
 
+Blob & Blob::operator=(const Blob & b) {
+ // borrowed data (of a BlobView) are copied into own storage: a view may not outlive
+ // its source, while a copy may
+ if(this == &b) return *this;
+ offset_ = b.offset_;
+ enc_ = b.enc_;
+ blob_.assign(b.rdata_(), b.rdata_() + b.rsize_());
+ view_ = nullptr;
+ vsize_ = 0;
+ base_ = b.base_;
+ pending_ = b.pending_;
+ limit_ = b.view_ != nullptr? SIZE_MAX: b.limit_;               // a copy of a view is appendable
+ cptr_ = b.cptr_;
+ vptr_ = b.vptr_;
+ return *this;
+}
+
+
+Blob & Blob::operator=(Blob && b) {
+ if(b.view_ != nullptr) return *this = static_cast<const Blob &>(b);    // a view is copied
+ offset_ = b.offset_;
+ enc_ = b.enc_;
+ blob_ = std::move(b.blob_);
+ view_ = nullptr;
+ vsize_ = 0;
+ base_ = b.base_;
+ pending_ = b.pending_;
+ limit_ = b.limit_;
+ cptr_ = std::move(b.cptr_);
+ vptr_ = std::move(b.vptr_);
+ return *this;
+}
+
+STRINGIFY(Blob::Encoding, ENCODING)
+#undef ENCODING
+
+
+
+class BlobView: public Blob {
+ // non-owning, restore-only Blob: de-serializes directly from a borrowed memory (e.g.
+ // sqlite3_column_blob(), a memory-mapped file), hence no copy of serialized data is
+ // made. It passes wherever Blob is expected (e.g. SERDES constructors/deserialize()),
+ // but supports only restore operations (append via Blob & throws, a copy as Blob copies
+ // the viewed data), e.g.:
+ //
+ //      BlobView bv("cache.bin");           // memory-map a file with serialized data
+ //      SomeClass x(bv);                    // restore directly from the mapped region
+ //
+ //      BlobView bv(ptr, size);             // or view any memory region
+ //      bv.restore(x, y, z);
+ //
+ // Borrowed memory must outlive the view (mapped file is owned by the view though)
+  friend std::ostream & operator<<(std::ostream &os, const BlobView & self) {
+                         os.write(reinterpret_cast<const char*>(self.data()), self.size());
+                         return os;
+                        }
+  friend void           swap(BlobView &l, BlobView &r) {
+                         using std::swap;                       // enable ADL
+                         swap(l.offset_, r.offset_);
+                         swap(l.enc_, r.enc_);
+                         swap(l.view_, r.view_);
+                         swap(l.vsize_, r.vsize_);
+                         swap(l.mapped_, r.mapped_);
+                        }
 
+ public:
+                        BlobView(void) { limit_ = 0; }          // DC: any append spills (throws)
+                        BlobView(const void *ptr, size_t size): BlobView()
+                         { view(ptr, size); }
+    explicit            BlobView(const std::string &file_name): BlobView()
+                         { map(file_name); }
+                        BlobView(const BlobView &) = delete;    // CC: owns mapping, not copyable
+                        BlobView(BlobView && other): BlobView() // MC
+                         { swap(*this, other); }
+                       ~BlobView(void) { unmap_(); }
+
+    BlobView &          operator=(const BlobView &) = delete;
+    BlobView &          operator=(BlobView && other)
+                         { swap(*this, other); return *this; }
+
+                        // view a memory region (not owned)
+    BlobView &          view(const void *ptr, size_t size) {
+                         unmap_();
+                         view_ = size == 0? empty_(): static_cast<const uint8_t*>(ptr);
+                         vsize_ = size;
+                         reset();
+                         return *this;
+                        }
+                        // memory-map entire file (read only)
+    BlobView &          map(const std::string &file_name);
+    BlobView &          clear(void)
+                         { unmap_(); view_ = nullptr; vsize_ = 0; reset(); return *this; }
+
+    size_t              size(void) const override { return vsize_; }
+    bool                is_mapped(void) const { return mapped_; }
+    const uint8_t *     data(void) const override { return view_; }
+    const uint8_t *     begin(void) const { return view_; }
+    const uint8_t *     cbegin(void) const { return view_; }
+    const uint8_t *     end(void) const { return view_ + vsize_; }
+    const uint8_t *     cend(void) const { return view_ + vsize_; }
 
+ private:
+    using               Blob::append;                           // view is restore-only
+    using               Blob::append_raw;
+    using               Blob::store;
+
+    static const uint8_t *
+                        empty_(void) { static const uint8_t e{0}; return &e; }
+    void                unmap_(void) {
+                         if(mapped_) munmap(const_cast<uint8_t*>(view_), vsize_);
+                         mapped_ = false;
+                        }
 
+    bool                mapped_{false};                         // view_ is mmap'ed by this object
+};
 
 
+BlobView & BlobView::map(const std::string &file_name) {
+ // memory-map a file with serialized data
+ clear();
+ int fd = open(file_name.c_str(), O_RDONLY);
+ if(fd < 0) throw EXP(could_not_map_file);
+ struct stat st;
+ if(fstat(fd, &st) != 0) { close(fd); throw EXP(could_not_map_file); }
+ if(st.st_size == 0) { close(fd); return view(nullptr, 0); }    // nothing to map
 
+ void * ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+ close(fd);                                                     // mapping persists w/o fd
+ if(ptr == MAP_FAILED) throw EXP(could_not_map_file);
+ view(ptr, st.st_size);
+ mapped_ = true;
+ return *this;
+}
 
 
 
+class BlobSink: public Blob {
+ // append-only Blob streaming serialized data into a file descriptor: data are
+ // accumulated in the buffer (blob_) of a fixed size and written out whenever it fills up.
+ // The sink must be flushed after the last append - destructor does it too, but errors
+ // then are silently ignored, thus to catch those call flush() explicitly
+ public:
+    explicit            BlobSink(int fd, size_t buffer = 1 << 16): fd_{fd}
+                         { limit_ = buffer < min_buffer_? min_buffer_: buffer; blob_.reserve(limit_); }
+    explicit            BlobSink(const std::string &file_name, size_t buffer = 1 << 16):
+                         BlobSink(::open(file_name.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644),
+                                  buffer)
+                         { if(fd_ < 0) throw EXP(could_not_open_file); own_ = true; }
+                        BlobSink(const BlobSink &) = delete;    // CC: owns fd, not copyable
+                       ~BlobSink(void) {
+                         try { flush(); } catch(stdException &) {}
+                         if(own_) ::close(fd_);
+                        }
+
+    BlobSink &          operator=(const BlobSink &) = delete;
+
+    BlobSink &          flush(void) {
+                         write_(blob_.data(), blob_.size());
+                         blob_.clear();
+                         return *this;
+                        }
+    size_t              flushed(void) const                     // bytes written out so far
+                         { return flushed_; }
+    int                 fd(void) const { return fd_; }
+
+ protected:
+    void                spill_(const void *ptr, size_t s) override {
+                         flush();
+                         if(s < limit_)                         // fits the buffer
+                          { auto bp = static_cast<const uint8_t*>(ptr);
+                            blob_.insert(blob_.end(), bp, bp + s); }
+                         else write_(ptr, s);                   // large chunks go directly
+                        }
+
+ private:
+    using               Blob::restore;                          // sink is append-only
+    using               Blob::restore_raw;
+    using               Blob::store;
+
+    void                write_(const void *ptr, size_t s);
+
+    static constexpr size_t
+                        min_buffer_{16};                        // fits any varint
+    int                 fd_;
+    bool                own_{false};                            // fd_ was opened by sink
+    size_t              flushed_{0};                            // bytes written so far
+};
+
 
+void BlobSink::write_(const void *ptr, size_t s) {
+ // write entire chunk, retrying partial/interrupted writes
+ auto bp = static_cast<const uint8_t*>(ptr);
+ for(size_t w = 0; w < s;) {
+  ssize_t r = ::write(fd_, bp + w, s - w);
+  if(r < 0) {
+   if(errno == EINTR) continue;
+   throw EXP(could_not_write_file);
+  }
+  w += r;
+ }
+ flushed_ += s;
+}
 
 
 
 
+class BlobSource: public Blob {
+ // restore-only Blob streaming serialized data from a file descriptor: the buffer (blob_)
+ // of a fixed size is refilled from the descriptor whenever restore runs out of data,
+ // offset() reflects the position in the whole stream
+ public:
+    explicit            BlobSource(int fd, size_t buffer = 1 << 16):
+                         fd_{fd}, chunk_{buffer < min_buffer_? min_buffer_: buffer} {
+                         struct stat st;                        // bytes known to be ahead
+                         off_t pos = ::lseek(fd_, 0, SEEK_CUR); // help validating counters
+                         pending_ = fstat(fd_, &st) == 0 and S_ISREG(st.st_mode) and pos >= 0?
+                                    static_cast<size_t>(st.st_size - pos): SIZE_MAX / 2;
+                         blob_.reserve(chunk_);
+                        }
+    explicit            BlobSource(const std::string &file_name, size_t buffer = 1 << 16):
+                         BlobSource(::open(file_name.c_str(), O_RDONLY), buffer)
+                         { if(fd_ < 0) throw EXP(could_not_open_file); own_ = true; }
+                        BlobSource(const BlobSource &) = delete;        // CC: not copyable
+                       ~BlobSource(void) { if(own_) ::close(fd_); }
+
+    BlobSource &        operator=(const BlobSource &) = delete;
+
+    bool                eof(void);                              // true if nothing to restore
+    int                 fd(void) const { return fd_; }
+
+ protected:
+    void                refill_(void *ptr, size_t s) override;
+
+ private:
+    using               Blob::append;                           // source is restore-only
+    using               Blob::append_raw;
+    using               Blob::store;
+
+    size_t              read_(uint8_t *ptr, size_t min, size_t max);
+
+    static constexpr size_t
+                        min_buffer_{16};
+    int                 fd_;
+    bool                own_{false};                            // fd_ was opened by source
+    size_t              chunk_;                                 // buffer size
+};
+
 
+void BlobSource::refill_(void *ptr, size_t s) {
+ // drain what's left in the buffer, then read the rest (directly, if it's a large chunk)
+ auto dst = static_cast<uint8_t*>(ptr);
+ size_t left = blob_.size() - offset_;
+ if(left > 0) memcpy(dst, blob_.data() + offset_, left);
+ dst += left;
+ s -= left;
+ base_ += blob_.size();
+ blob_.clear();
+ offset_ = 0;
+
+ if(s >= chunk_) {
+  if(read_(dst, s, s) < s) throw EXP(inconsistent_data_while_restoring);
+  base_ += s;
+  return;
+ }
+ blob_.resize(chunk_);
+ blob_.resize(read_(blob_.data(), s, chunk_));
+ if(blob_.size() < s) throw EXP(inconsistent_data_while_restoring);
+ memcpy(dst, blob_.data(), s);
+ offset_ = s;
+}
+
+
+bool BlobSource::eof(void) {
+ if(offset_ < blob_.size()) return false;
+ base_ += blob_.size();
+ offset_ = 0;
+ blob_.resize(chunk_);
+ blob_.resize(read_(blob_.data(), 1, chunk_));
+ return blob_.empty();
+}
+
+
+size_t BlobSource::read_(uint8_t *ptr, size_t min, size_t max) {
+ // read at least min bytes (unless end of file is reached) up to max bytes
+ size_t got = 0;
+ while(got < min) {
+  ssize_t r = ::read(fd_, ptr + got, max - got);
+  if(r < 0) {
+   if(errno == EINTR) continue;
+   throw EXP(could_not_read_file);
+  }
+  if(r == 0) break;                                             // end of file
+  got += r;
+ }
+ pending_ -= std::min(got, pending_);
+ return got;
+}
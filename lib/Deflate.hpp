@@ -0,0 +1,270 @@
+/*
+ * Created by Dmitry Lyssenko
+ *
+ * Deflate: zlib codec of (text) values stored in sqlite as BLOBs (requires -lz)
+ *
+ * 1. compress / decompress:
+ *
+ *  Deflate z;                              // or: Deflate z{dictionary};
+ *  std::string blob = z.compress(text);    // zlib stream (RFC 1950)
+ *  std::string text = Deflate::decompress(blob);
+ *
+ *  // a Deflate object keeps its zlib state between compress() calls (hence it's cheap
+ *  // compressing many small values), but it's not copyable
+ *
+ *
+ * 2. preset dictionaries:
+ *
+ *  // values sharing a lot of content (e.g., JSON documents of the same layout) compress
+ *  // much better with a preset dictionary, one could be trained from sample values:
+ *
+ *  Deflate z{ Deflate::train(samples) };   // samples: std::vector<std::string>
+ *
+ *  // a zlib stream compressed with a dictionary refers to it by the id (adler32 of the
+ *  // dictionary, z.id()), thus decompression requires a lookup of dictionaries by id:
+ *
+ *  Deflate::decompress(blob, [&dicts](uint32_t id) { return dicts[id]; });
+ *
+ *  // training counts k-grams occurring in different samples, the most frequent ones are
+ *  // chained into segments, which are laid out most frequent last (as zlib recommends)
+ *
+ *
+ * 3. sqlite function:
+ *
+ *  Deflate::register_functions(db);        // db: sqlite3 * connection
+ *
+ *  // registers SQL function jsl_decompress(x): a BLOB holding a zlib stream is returned
+ *  // decompressed as TEXT (dictionaries are read from table DFL_DICT_TBL of the same db:
+ *  // id INTEGER PRIMARY KEY, dict BLOB), any other value is returned as is, e.g.:
+ *  //      SELECT jsl_decompress(payload) FROM events;
+ *  // the same function could be loaded into sqlite3 shell as an extension (see jsl_ext.cpp)
+ */
+
+#pragma once
+
+#include <zlib.h>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include "extensions.hpp"
+
+
+#define DFL_DICT_TBL "jsl_dict"                                 // table of dictionaries
+#define DFL_DICT_SIZE 32768                                     // max dictionary (deflate window)
+#define DFL_KGRAM 8                                             // k-gram length in training
+
+
+
+class Deflate {
+ public:
+    #define THROWREASON \
+                could_not_compress, \
+                could_not_decompress, \
+                missing_dictionary
+    ENUMSTR(ThrowReason, THROWREASON)
+
+    typedef std::function<std::string(uint32_t)> DictLookup;
+
+                        Deflate(void) = default;
+                        Deflate(std::string dict): dict_{std::move(dict)}
+                         { if(not dict_.empty()) id_ = adler32_(dict_); }
+                        Deflate(const Deflate &) = delete;
+                       ~Deflate(void) { if(init_) deflateEnd(&zs_); }
+    Deflate &           operator=(const Deflate &) = delete;
+
+    const std::string & dictionary(void) const { return dict_; }
+    uint32_t            id(void) const { return id_; }          // dictionary id (0: none)
+    std::string         compress(const std::string & text);
+
+    static bool         is_compressed(const void *data, size_t size);
+    static std::string  decompress(const std::string & blob, DictLookup lookup = nullptr);
+    static std::string  train(const std::vector<std::string> & samples,
+                              size_t size = DFL_DICT_SIZE);
+    static int          register_functions(sqlite3 *db);
+
+    EXCEPTIONS(ThrowReason)                                     // see "extensions.hpp"
+
+ private:
+    typedef std::unordered_map<uint32_t, std::string> Dicts;    // dictionaries cache (by id)
+
+    static uint32_t     adler32_(const std::string & s)
+                         { return adler32(adler32(0, Z_NULL, 0),
+                                          reinterpret_cast<const Bytef *>(s.data()), s.size()); }
+    static void         decompress_fn_(sqlite3_context *ctx, int argc, sqlite3_value **argv);
+
+    std::string         dict_;
+    uint32_t            id_{0};
+    z_stream            zs_;
+    bool                init_{false};                           // zs_ is initialized
+};
+
+STRINGIFY(Deflate::ThrowReason, THROWREASON)
+#undef THROWREASON
+
+
+
+
+std::string Deflate::compress(const std::string & text) {
+ // compress text into zlib stream (with dictionary, if any)
+ if(not init_) {
+  zs_ = z_stream{};
+  if(deflateInit(&zs_, Z_DEFAULT_COMPRESSION) != Z_OK) throw EXP(could_not_compress);
+  init_ = true;
+ }
+ else deflateReset(&zs_);
+ if(not dict_.empty())
+  if(deflateSetDictionary(&zs_, reinterpret_cast<const Bytef *>(dict_.data()),
+                          dict_.size()) != Z_OK) throw EXP(could_not_compress);
+
+ std::string blob(deflateBound(&zs_, text.size()), '\0');
+ zs_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(text.data()));
+ zs_.avail_in = text.size();
+ zs_.next_out = reinterpret_cast<Bytef *>(&blob[0]);
+ zs_.avail_out = blob.size();
+ if(deflate(&zs_, Z_FINISH) != Z_STREAM_END) throw EXP(could_not_compress);
+ blob.resize(zs_.total_out);
+ return blob;
+}
+
+
+
+bool Deflate::is_compressed(const void *data, size_t size) {
+ // check zlib stream header: deflate method, window up to 32K, header checksum
+ auto h = static_cast<const uint8_t *>(data);
+ return size > 6 and (h[0] & 0x0F) == Z_DEFLATED and (h[0] >> 4) <= 7 and
+        (h[0] << 8 | h[1]) % 31 == 0;
+}
+
+
+
+std::string Deflate::decompress(const std::string & blob, DictLookup lookup) {
+ // inflate zlib stream, a dictionary (if the stream requires one) is looked up by its id
+ z_stream zs{};
+ if(inflateInit(&zs) != Z_OK) throw Deflate{}.EXP(could_not_decompress);
+ zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(blob.data()));
+ zs.avail_in = blob.size();
+
+ std::string text(std::max<size_t>(blob.size() * 4, 64), '\0');
+ for(int rc = Z_OK; rc != Z_STREAM_END;) {
+  if(zs.total_out == text.size()) text.resize(text.size() * 2);
+  zs.next_out = reinterpret_cast<Bytef *>(&text[zs.total_out]);
+  zs.avail_out = text.size() - zs.total_out;
+  rc = inflate(&zs, Z_NO_FLUSH);
+  if(rc == Z_NEED_DICT) {
+   std::string dict = lookup? lookup(zs.adler): std::string{};
+   if(dict.empty() or
+      inflateSetDictionary(&zs, reinterpret_cast<const Bytef *>(dict.data()), dict.size())
+       != Z_OK)
+    { inflateEnd(&zs); throw Deflate{}.EXP(missing_dictionary); }
+   continue;
+  }
+  if(rc == Z_STREAM_END) break;
+  if(rc == Z_BUF_ERROR and zs.avail_in == 0)                    // truncated (or empty) stream
+   { inflateEnd(&zs); throw Deflate{}.EXP(could_not_decompress); }
+  if(rc != Z_OK and not (rc == Z_BUF_ERROR and zs.avail_out == 0))
+   { inflateEnd(&zs); throw Deflate{}.EXP(could_not_decompress); }
+ }
+ text.resize(zs.total_out);
+ inflateEnd(&zs);
+ return text;
+}
+
+
+
+std::string Deflate::train(const std::vector<std::string> & samples, size_t size) {
+ // build a dictionary of content common across samples: k-grams are counted once per sample,
+ // those found in 2+ samples are taken by frequency (then by the first occurrence, thus
+ // k-grams of a common phrase come in order and chain into a segment); most frequent
+ // segments are placed at the end of the dictionary
+ struct Gram { size_t count; size_t first; size_t sample; };
+ std::unordered_map<std::string, Gram> grams;
+ size_t pos = 0;
+ for(size_t s = 0; s < samples.size(); pos += samples[s++].size())
+  for(size_t i = 0; i + DFL_KGRAM <= samples[s].size(); ++i) {
+   auto & g = grams.emplace(samples[s].substr(i, DFL_KGRAM), Gram{0, pos + i, SIZE_MAX})
+                   .first->second;
+   if(g.sample != s) { ++g.count; g.sample = s; }
+  }
+
+ std::vector<const std::pair<const std::string, Gram> *> common;
+ for(auto & g: grams)
+  if(g.second.count > 1) common.push_back(&g);
+ std::sort(common.begin(), common.end(), [](auto l, auto r) {
+            return l->second.count != r->second.count?
+                   l->second.count > r->second.count: l->second.first < r->second.first;
+           });
+
+ std::vector<std::string> segments;
+ std::unordered_set<std::string> taken;
+ size_t total = 0;
+ for(auto g: common) {
+  if(total >= size) break;
+  const std::string & gram = g->first;
+  if(taken.count(gram) == 1) continue;
+  if(not segments.empty() and                                   // chain into the last segment
+     segments.back().compare(segments.back().size() - DFL_KGRAM + 1, DFL_KGRAM - 1,
+                             gram, 0, DFL_KGRAM - 1) == 0)
+   { segments.back() += gram.back(); ++total; }
+  else
+   { segments.push_back(gram); total += DFL_KGRAM; }
+  taken.insert(gram);
+ }
+
+ std::string dict;
+ for(auto it = segments.rbegin(); it != segments.rend(); ++it) dict += *it;
+ return dict.size() > size? dict.substr(dict.size() - size): dict;
+}
+
+
+
+int Deflate::register_functions(sqlite3 *db) {
+ // register jsl_decompress(x) over db connection (with own dictionaries cache)
+ return sqlite3_create_function_v2(db, "jsl_decompress", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                   new Dicts, &Deflate::decompress_fn_, nullptr, nullptr,
+                                   [](void *dicts) { delete static_cast<Dicts *>(dicts); });
+}
+
+
+
+void Deflate::decompress_fn_(sqlite3_context *ctx, int, sqlite3_value **argv) {
+ // SQL function jsl_decompress(x): decompress BLOB holding zlib stream, others pass as is
+ if(sqlite3_value_type(argv[0]) != SQLITE_BLOB)                // must precede value conversions
+  return sqlite3_result_value(ctx, argv[0]);
+ const void * data = sqlite3_value_blob(argv[0]);
+ size_t size = sqlite3_value_bytes(argv[0]);
+ if(not is_compressed(data, size)) return sqlite3_result_value(ctx, argv[0]);
+
+ auto dicts = static_cast<Dicts *>(sqlite3_user_data(ctx));
+ auto lookup = [ctx, dicts](uint32_t id) {                      // dictionary by id: cached, or
+                auto found = dicts->find(id);                   // read from the db
+                if(found != dicts->end()) return found->second;
+                std::string dict;
+                sqlite3_stmt *stmt;
+                if(sqlite3_prepare_v2(sqlite3_context_db_handle(ctx),
+                                      "SELECT dict FROM " DFL_DICT_TBL " WHERE id = ?;", -1,
+                                      &stmt, nullptr) == SQLITE_OK) {
+                 sqlite3_bind_int64(stmt, 1, id);
+                 if(sqlite3_step(stmt) == SQLITE_ROW)
+                  dict.assign(static_cast<const char *>(sqlite3_column_blob(stmt, 0)),
+                              sqlite3_column_bytes(stmt, 0));
+                 sqlite3_finalize(stmt);
+                }
+                if(not dict.empty()) (*dicts)[id] = dict;
+                return dict;
+               };
+ try {
+  std::string text = decompress(std::string{static_cast<const char *>(data), size}, lookup);
+  sqlite3_result_text(ctx, text.data(), text.size(), SQLITE_TRANSIENT);
+ }
+ catch(stdException & e) {
+  if(e.code() == could_not_decompress) return sqlite3_result_value(ctx, argv[0]);
+  sqlite3_result_error(ctx, e.what(), -1);                      // missing dictionary
+ }
+}
+
+
+#undef DFL_KGRAM
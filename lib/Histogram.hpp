@@ -0,0 +1,130 @@
+/*
+ * Created by Dmitry Lyssenko
+ *
+ * Histogram: HDR-style histogram of (integer) values, e.g. latencies in nanoseconds
+ *
+ * values are counted in log-linear buckets: values below 2 * HST_SUB are counted exactly,
+ * above that each power of 2 range is split into HST_SUB buckets, thus a value is resolved
+ * with a relative error within 1/HST_SUB (~1.6%); recording a value is O(1) (no search and
+ * no allocation), the entire range of uint64_t is covered
+ *
+ *  Histogram h;
+ *  h.record(elapsed_ns);                   // count a value
+ *  h.count(); h.min(); h.max(); h.mean();
+ *  h.percentile(99.9);                     // value at given percentile (its bucket's top)
+ *  h.merge(other);                         // e.g. merge histograms recorded by own threads
+ *
+ * Histogram is not thread safe: each thread should record into own histogram, those are
+ * merged later
+ *
+ * Timer measures elapsed time between its construction (or the last reset) and a record:
+ *
+ *  Histogram::Timer t;
+ *  ...
+ *  h.record(t.elapsed());                  // elapsed nanoseconds
+ */
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+
+#define HST_BITS 6                                              // sub-bucket bits
+#define HST_SUB (1 << HST_BITS)                                 // sub-buckets per power of 2
+#define HST_BUCKETS ((63 - HST_BITS) * HST_SUB + 2 * HST_SUB)   // covers 0 .. UINT64_MAX
+
+
+
+class Histogram {
+ public:
+    class Timer;
+
+                        Histogram(void): counts_(HST_BUCKETS, 0) {}
+
+    void                record(uint64_t v) {
+                         ++counts_[index_(v)];
+                         ++count_;
+                         sum_ += v;
+                         min_ = std::min(min_, v);
+                         max_ = std::max(max_, v);
+                        }
+    Histogram &         merge(const Histogram &h);
+    void                clear(void) { *this = Histogram{}; }
+
+    uint64_t            count(void) const { return count_; }
+    uint64_t            min(void) const { return count_ == 0? 0: min_; }
+    uint64_t            max(void) const { return max_; }
+    double              mean(void) const { return count_ == 0? 0: double(sum_) / count_; }
+    uint64_t            percentile(double p) const;
+
+ private:
+    static size_t       index_(uint64_t v) {                    // shift = 0 for v < 2 * HST_SUB
+                         int msb = v == 0? 0: 63 - __builtin_clzll(v);
+                         int shift = std::max(0, msb - HST_BITS);
+                         return (static_cast<size_t>(shift) << HST_BITS) + (v >> shift);
+                        }
+    static uint64_t     top_(size_t idx) {                      // highest value of bucket idx
+                         if(idx < 2 * HST_SUB) return idx;
+                         int shift = (idx >> HST_BITS) - 1;
+                         uint64_t low = static_cast<uint64_t>(idx % HST_SUB + HST_SUB) << shift;
+                         return low + ((1ULL << shift) - 1);
+                        }
+
+    std::vector<uint64_t>
+                        counts_;                                // counts by buckets
+    uint64_t            count_{0};
+    uint64_t            sum_{0};
+    uint64_t            min_{UINT64_MAX};
+    uint64_t            max_{0};
+};
+
+
+
+class Histogram::Timer {
+ public:
+                        Timer(void): start_{std::chrono::steady_clock::now()} {}
+
+    void                reset(void) { start_ = std::chrono::steady_clock::now(); }
+    uint64_t            elapsed(void) const {                   // nanoseconds since start
+                         return std::chrono::duration_cast<std::chrono::nanoseconds>
+                                 (std::chrono::steady_clock::now() - start_).count();
+                        }
+ private:
+    std::chrono::steady_clock::time_point
+                        start_;
+};
+
+
+
+
+Histogram & Histogram::merge(const Histogram &h) {
+ for(size_t i = 0; i < counts_.size(); ++i) counts_[i] += h.counts_[i];
+ count_ += h.count_;
+ sum_ += h.sum_;
+ min_ = std::min(min_, h.min_);
+ max_ = std::max(max_, h.max_);
+ return *this;
+}
+
+
+
+uint64_t Histogram::percentile(double p) const {
+ // return the value at percentile p (top of the bucket where the percentile falls into,
+ // but not above the max recorded value)
+ if(count_ == 0) return 0;
+ uint64_t rank = std::max<uint64_t>(1, std::ceil(p / 100. * count_));
+ uint64_t seen = 0;
+ for(size_t i = 0; i < counts_.size(); ++i)
+  if((seen += counts_[i]) >= rank) return std::min(top_(i), max_);
+ return max_;
+}
+
+
+
+#undef HST_BITS
+#undef HST_SUB
+#undef HST_BUCKETS
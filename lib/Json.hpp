@@ -43,6 +43,11 @@
  *  ,or use a string with _json suffix:
  *      json = R"({ "label 1": [ null, true, 2, "three" ] })"_json;
  *
+ *  ,or parse input made of records (a JSON array of records, or NDJSON) skipping the
+ *  malformed ones (see parse_records() for resynchronization rules):
+ *      json.parse_records(str, [](const Json::Reject &r) { std::cerr << r.offset; });
+ *  (an optional 3rd callback is called upon each parsed record, before it's collected)
+ *
  *
  * 2. Accessing JSON
  *  Say, we have a following JSON:
@@ -231,11 +236,24 @@
  *      is_atomic()     // i.e. string/number/bull/null
  *
  *  Json threes could be compared using '==' and '!=' operators.
- *      size() - calculates entire JSON tree size (number of nodes)
+ *      size() - returns entire JSON tree size (number of nodes): sizes of iterables
+ *               are cached per node (computed at parse time), a modification adds the
+ *               size change of the modified node to the cached sizes of its ancestors
+ *               (see hash()), thus size() remains O(1) while JSON is being edited
  *      has_children() - checks if given Json actually has any children (atomic
  *                       values would return false unconditionally
  *      children(void) - returns how many immediate children a JSON has (atomic
  *                       json always return 0)
+ *      hash() - returns a 64 bit structural hash of a JSON (sub)tree: it does not depend
+ *               on formatting and is consistent with '==' (equal JSONs hash equally),
+ *               it's stable across runs (though not across platforms of different
+ *               endianness). Hashes of iterables are cached: a modification (assignment,
+ *               push_back(), erase(), insertion of a new label, etc.) voids cached data of
+ *               the modified node and of its ancestors only (each node is linked to its
+ *               parent), thus modifying a node via a retained reference or a walk iterator
+ *               never leaves stale hashes in its parents, while the rest of the tree (as
+ *               well as non-modifying access, e.g. subscripts of existing labels) keeps
+ *               caches intact; hash(false) recalculates the whole subtree regardless
  *
  *  Facilitating iterations:
  *      begin() - returns iterator / const_iterator
@@ -251,7 +269,7 @@
  *                (methods label() and value() facilitate the same meaning as members
  *                'first' and 'second' when dereferencing map's iterators)
  *
- *  Global Json class printing option:
+ *  Json class printing options (apply to all JSONs printed in the calling thread):
  *      pretty() - instructs to output JSON using pretty format
  *      raw() - instructs to output JSON in one line
  *      tab() - let setting tab size used for indention (default is 3)
@@ -392,8 +410,11 @@
  *   'invalidate' - i.e. upon every new walk the entire search cache will be
  *   invalidated (cleared). If a user wants to keep the cache, he need to specify
  *   'keep_cache' keyword explicitly (at least the decision is conscious)
- *   CAUTION: Keeping the search cache after JSON has been modified may lead to
- *            undefined behavior.
+ *   Kept cache entries are stamped with the node the search begins from and are
+ *   revalidated by that stamp: modifying a node (however it's reached - chained from
+ *   the root, via a retained reference, or a walk iterator) re-stamps the node and all
+ *   its ancestors, thus only searches covering the modified node are rebuilt, while
+ *   the rest of the cache is reused
  *
  *
  *  Some examples:
@@ -451,6 +472,93 @@
  *  and thus the supernode's lifetime is the same as iterator's from which it was
  *  dereferenced.
  *
+ *
+ * 8. Copy-on-write
+ *  copies of Jnode (Json) are O(1), while each copy remains an independent value:
+ *      Json copy = json;               // or: Jnode copy = json["Address Book"];
+ *  - children of iterables are shared by both and detached (copied, one level at a time)
+ *  once either side accesses them for modification through Jnode interface (subscripts,
+ *  front(), back(), begin(), find(), push_back(), erase(), etc.); read-only access (const
+ *  interface, printing, hash(), walking) never detaches. Walk iterators re-resolve their
+ *  paths (by labels) once the nodes they point into got detached, and modifying a node via
+ *  a walk iterator detaches the path to the node first, thus never affects other copies
+ *  (share() is kept as an equivalent of a copy)
+ *  CAUTION: Jnode references and Jnode::iterators are not re-resolved: modifying a node via
+ *           a reference retained from before the JSON was copied affects the copy too
+ *
+ *  Documents repeating identical subtrees could be parsed with interning (hash-consing):
+ *      json.intern_subtrees().parse(str);
+ *  - then all identical (non-empty) iterables share the same children (stored once),
+ *  which cuts memory of repetitive documents; sharing is subject to the same copy-on-
+ *  write rules (thus modifying a subtree detaches it from its identical ones)
+ *
+ *
+ * 9. Thread safety
+ *  print settings (pretty(), raw(), tab()) are thread-local, so different threads may
+ *  process (and print) their own JSONs without locks. The guarantees are those of standard
+ *  containers:
+ *  - const access (incl. hash(), size(), printing) to the same Json may run concurrently:
+ *    cached hashes, sizes and stamps are relaxed atomics, racing readers store the same values
+ *  - Jsons sharing children (copies, interning) may be used by different threads, each
+ *    Json by one thread, incl. its modification and walking (shared nodes are detached
+ *    before being modified, walking does not modify nodes)
+ *  - a Json being modified or walked (walk() updates the search cache) must not be
+ *    accessed by other threads concurrently
+ *
+ *
+ * 10. Patching JSON
+ *  deltas could be applied to a Json in place (w/o rebuilding the document):
+ *      json.patch(R"([
+ *                  { "op": "replace", "path": "/Address Book/0/Name", "value": "Emmett" },
+ *                  { "op": "add", "path": "/Address Book/1/Phone/Work", "value": [] }
+ *                 ])"_json);
+ *      - applies RFC 6902 JSON Patch: operations add, remove, replace, move, copy, test
+ *        (locations are given as RFC 6901 JSON Pointers); if any operation fails, the
+ *        ones already applied are rolled back and the exception is thrown (patch_*)
+ *
+ *      json.merge_patch(R"({ "Address Book": null })"_json);
+ *      - applies RFC 7386 JSON Merge Patch
+ *
+ *  only nodes on the patched paths are modified (hence have their cached hashes, sizes
+ *  and search cache stamps invalidated), so the cost of patching is proportional to the
+ *  touched paths rather than to the document size (inserting into / removing from an
+ *  array re-indexes the array's tail though)
+ *
+ *
+ * 11. Binary input
+ *  CBOR and MessagePack are decoded straight into Jnode tree (see Jbin below):
+ *      Json json{ Jbin::from_cbor(bytes) };
+ *      Json json{ Jbin::from_msgpack(bytes, Json::Limits{64, 1 << 20, 0, 10000000, 0}) };
+ *      - resource limits (see 12) depth, string (decoded characters) and nodes apply to the
+ *        whole input (throwing Jbin's limit_* exceptions), number and regex limits do not;
+ *        binary input is never read as records (a malformed input fails entirely)
+ *
+ *
+ * 12. Resource limits
+ *  parsing and walking could be guarded against pathological inputs:
+ *      json.limits(Json::Limits{64, 1 << 20, 100, 10000000, 100000}).parse(str);
+ *      - limits: nesting depth, string length, number length, nodes (values and labels),
+ *        steps per regex evaluation (0 - no limit, the default); exceeding a limit throws
+ *        limit_* exception with exception_point() set at the offending spot; parse_records()
+ *        applies limits per record (i.e., only the violating record is rejected)
+ *
+ *  the regex limit applies to walks built after it's set: regexes then are compiled with
+ *  `collate' flag, which makes the matcher translate each compared character (via traits),
+ *  that's what is counted (collation is kept to the plain char order, thus character
+ *  ranges match the same way as in walks w/o the limit)
+ *
+ *
+ * 13. Tape layout
+ *  read-only processing of large documents could be done over Jtape - an immutable
+ *  layout of a JSON in one contiguous array (see Jtape below):
+ *      Jtape tape(json.root());
+ *      for(auto & node: tape.walk("[Address Book] <Street>l+0"))
+ *       std::cout << node << std::endl;
+ *      - nodes are laid out in pre-order, each with a skip offset (its subtree size), so
+ *        iterating children or pruning a traversal jumps over whole subtrees in O(1);
+ *        walks over the tape support a subset of lexemes (see Jtape), printing follows
+ *        Jnode's settings, to_jnode() returns the mutable tree again
+ *
  * Json class is DEBUGGABLE - see dbg.hpp
  */
 
@@ -459,7 +567,13 @@
 #include <exception>
 #include <vector>
 #include <map>
+#include <unordered_map>        // interning pool
+#include <memory>               // std::shared_ptr
+#include <atomic>               // std::atomic (cache stamps)
 #include <string>
+#include <cstring>              // memcpy
+#include <cstdio>               // snprintf (Jbin)
+#include <cmath>                // std::ldexp, std::isfinite (Jbin)
 #include <functional>           // function objects
 #include <sstream>              // std::stringstream
 #include <utility>              // std::forward, std::move, std::make_pair, ...
@@ -534,6 +648,25 @@
 // NOTE: solidus quotation is optional per JSON spec, a user will have an option
 //       to chose between desired quotation behavior
 
+// an atomic (relaxed by default) value which could be copied: caches in Jnode are
+// updated by const methods, thus may be written by concurrent readers
+template<typename T>
+class Relaxed {
+ public:
+                        Relaxed(T v = T{}): v_{v} {}
+                        Relaxed(const Relaxed &r): v_{r} {}
+    Relaxed &           operator=(const Relaxed &r) { return *this = static_cast<T>(r); }
+    Relaxed &           operator=(T v) { store(v); return *this; }
+                        operator T(void) const { return load(); }
+    T                   load(std::memory_order o = std::memory_order_relaxed) const
+                         { return v_.load(o); }
+    void                store(T v, std::memory_order o = std::memory_order_relaxed)
+                         { v_.store(v, o); }
+ private:
+    std::atomic<T>      v_;
+};
+
+
 // template meta to calculate number of bits required to represent an integer
 template<uint64_t I>
 struct bits { enum { num = 1 + bits<(I>>1)>::num }; };
@@ -547,17 +680,20 @@ struct bits<1> { enum { num = 1 }; };
 class Json;
 class Jnode {
     friend class Json;
+    friend class Jbin;                                          // see Jbin below
+    friend class Jtape;                                         // see Jtape below
 
   friend std::ostream & operator<<(std::ostream & os, const Jnode & jnode)
                          { int rl{0}; return print_json_(os, jnode, rl); }
 
     friend void         swap(Jnode &l, Jnode &r) {
-                         using std::swap;                       // enable ADL
                          auto & lv = l.value();                 // first resolve super node
                          auto & rv = r.value();
-                         swap(lv.type_, rv.type_);
-                         swap(lv.value_, rv.value_);
-                         swap(lv.descendants_, rv.descendants_);
+                         bool linked = lv.up_ != nullptr or rv.up_ != nullptr;  // in a tree
+                         long ls = linked? lv.size(): 0, rs = linked? rv.size(): 0;
+                         lv.swap_(rv);
+                         lv.resized_(rs - ls);                  // ancestors follow the sizes
+                         rv.resized_(ls - rs);
                         }
 
     typedef std::map<std::string, Jnode> map_jn;
@@ -603,6 +739,15 @@ class Jnode {
                 walk_bad_suffix, \
                 walk_bad_position, \
                 walk_a_bug, \
+                patch_bad_operation, \
+                patch_bad_pointer, \
+                patch_path_not_found, \
+                patch_test_failed, \
+                limit_depth_exceeded, \
+                limit_string_exceeded, \
+                limit_number_exceeded, \
+                limit_nodes_exceeded, \
+                limit_regex_exceeded, \
                 end_of_throw
     ENUMSTR(ThrowReason, THROWREASON)
 
@@ -632,7 +777,9 @@ class Jnode {
                          // leads to the crash inevitably. "volatile" disables such optimization
                          type_ = jnv->type_;
                          value_ = jnv->value_;
-                         descendants_ = jnv->descendants_;
+                         descendants_ = jnv->descendants_;      // O(1): children are shared
+                         hash_ = jnv->hash_;
+                         size_ = jnv->size_;
                         }
 
                         Jnode(Jnode &&jn): Jnode() {            // MC
@@ -643,10 +790,15 @@ class Jnode {
                         }
 
     Jnode &             operator=(Jnode jn) {                   // CA, MA
-                         swap(*this, jn);
+                         swap(*this, jn);                       // maintains caches of parents
                          return *this;
                         }
 
+                        ~Jnode(void) {                          // children lose their holder
+                         if(descendants_ and descendants_->owner == this)
+                          descendants_->owner = nullptr;
+                        }
+
                         // type conversions from Json:
                         Jnode(Json j);
 
@@ -695,7 +847,7 @@ class Jnode {
 
                         // class interface:
     Jtype               type(void) const { return value().type_; }
-    Jtype &             type(void) { return value().type_; }
+    Jtype &             type(void) { value().touched_(); return value().type_; }
     bool                is_object(void) const { return type() == Object; }
     bool                is_array(void) const { return type() == Array; }
     bool                is_string(void) const { return type() == String; }
@@ -706,9 +858,14 @@ class Jnode {
     bool                is_atomic(void) const { return type() > Array; }
 
     size_t              size(void) const {                      // entire Jnode size
-                         size_t size = 1;
-                         for(auto &child: children_())
+                         auto & my = value();
+                         if(my.is_atomic()) return 1;
+                         size_t size = my.size_;
+                         if(size != 0) return size;
+                         size = 1;                              // not cached: recalculate
+                         for(auto &child: my.children_())
                           size += child.VALUE.size();
+                         my.size_ = size;
                          return size;
                         }
 
@@ -723,7 +880,9 @@ class Jnode {
 
     Jnode &             clear(void) {
                          if(is_atomic()) throw EXP(type_non_iterable);
+                         long delta = 1 - static_cast<long>(size());
                          children_().clear();
+                         value().touched_(delta);
                          return *this;
                         }
 
@@ -741,7 +900,11 @@ class Jnode {
 
     Jnode &             operator[](const std::string & l) {
                          if(not is_object()) throw EXP(type_non_subscriptable);
-                         return children_()[l];
+                         auto & children = children_();
+                         auto found = children.find(l);
+                         if(found != children.end()) return found->VALUE;
+                         value().touched_(1);                   // new label is inserted
+                         return children[l];
                         }
 
     const Jnode &       operator[](const std::string & l) const {
@@ -781,11 +944,15 @@ class Jnode {
 
     bool                operator==(const Jnode &jn) const {
                          if(type() != jn.type()) return false;
-                         if(is_iterable()) return children_() == jn.children_();
+                         if(is_iterable())                      // shared children are equal
+                          return value().descendants_ == jn.value().descendants_ or
+                                 children_() == jn.children_();
                          else return val() == jn.val();
                         }
 
     bool                operator!=(const Jnode &jn) const { return not operator==(jn); }
+    uint64_t            hash(bool cached = true) const;         // structural hash of the tree
+    Jnode               share(void) const;                      // O(1) copy sharing children
 
                         // access json types (type checked)
     const std::string & str(void) const {
@@ -812,19 +979,22 @@ class Jnode {
                         // modify json
     Jnode &             erase(const std::string & l) {
                          if(not is_object()) throw EXP(expected_object_type);
-                         children_().erase(l);
+                         auto it = children_().find(l);
+                         if(it != children_().end()) erase_(it);
                          return *this;
                         }
 
     Jnode &             erase(size_t i) {
                          if(not is_array()) throw EXP(expected_array_type);
-                         children_().erase(iterator_by_idx_(i));
+                         erase_(iterator_by_idx_(i));
                          return *this;
                         }
 
     Jnode &             push_back(Jnode jn) {
                          if(not is_array()) throw EXP(expected_array_type);
+                         long delta = jn.size();
                          children_().emplace(next_key_(), std::move(jn));
+                         value().touched_(delta);               // maintain cached sizes
                          return *this;
                         }
 
@@ -832,7 +1002,7 @@ class Jnode {
     Jnode &             pop_back(void) {
                          if(not is_iterable()) throw EXP(type_non_iterable);
                          if(not children_().empty())
-                          children_().erase(std::prev(children_().end()));
+                          erase_(std::prev(children_().end()));
                          return *this;
                         }
 
@@ -894,28 +1064,138 @@ class Jnode {
  protected:
                         Jnode(Jtype t):type_{t} {}              // for internal use
 
-    map_jn &            children_(void) { return value().descendants_; }
-    const map_jn &      children_(void) const { return value().descendants_; }
+    struct Kids: map_jn {                                       // children of an iterable
+                            Kids(void) = default;
+                            Kids(const Kids &) = delete;        // id must remain unique
+
+                            // insertions link a child to its parent (owner):
+        template<typename... Args>
+        std::pair<iterator, bool>
+                            emplace(Args &&... args) {
+                             auto r = map_jn::emplace(std::forward<Args>(args)...);
+                             r.first->VALUE.up_ = this;
+                             return r;
+                            }
+        template<typename... Args>
+        iterator            emplace_hint(const_iterator hint, Args &&... args) {
+                             auto it = map_jn::emplace_hint(hint, std::forward<Args>(args)...);
+                             it->VALUE.up_ = this;
+                             return it;
+                            }
+        Jnode &             operator[](const std::string & l) {
+                             auto & jn = map_jn::operator[](l);
+                             jn.up_ = this;
+                             return jn;
+                            }
+
+        uint64_t            id{++kids_};                        // tells a detached copy apart
+        Jnode *             owner{nullptr};                     // node holding them (parent)
+    };
+
+                        // non-const access is treated as an access for modification: shared
+                        // children are detached (copy-on-write); cached hashes, sizes and
+                        // search cache stamps are voided by modifiers (touched_())
+    Kids &              children_(void) { return value().own_(); }
+    const Kids &        children_(void) const {
+                         static const Kids empty;
+                         return value().descendants_? *value().descendants_: empty;
+                        }
+                        // walk is read-only: it never detaches what it visits (walk iterators
+                        // are re-resolved instead, see "Copy-on-write" notes)
+    Kids &              walk_children_(void) const
+                         { return const_cast<Kids &>(children_()); }
+    Kids &              own_(void) {                            // detach shared descendants
+                         if(not descendants_)
+                          descendants_ = std::make_shared<Kids>();
+                         else if(descendants_.use_count() > 1) {
+                          auto shared = std::move(descendants_);
+                          descendants_ = std::make_shared<Kids>();
+                          for(auto & child: *shared)            // one level: children share
+                           descendants_->emplace_hint(descendants_->end(), child.KEY, child.VALUE);
+                          for(Jnode * jn = this; jn != nullptr; jn = jn->parent_())
+                           jn->stamp_ = 0;                      // cached searches are in shared
+                         }
+                         descendants_->owner = this;
+                         return *descendants_;
+                        }
+    void                adopt_(const Jnode & jn) {              // take over children from jn
+                         if(descendants_ and descendants_->owner == &jn) descendants_->owner = this;
+                        }
+    Jnode *             parent_(void) const { return up_ == nullptr? nullptr: up_->owner; }
     iter_jn             iterator_by_idx_(size_t idx);
     const_iter_jn       iterator_by_idx_(size_t idx) const;
     std::string         next_key_(void) const;
+    void                insert_(size_t idx, Jnode jn);          // insert into array, shift tail
+    Jnode               extract_(size_t idx);                   // extract from array, shift tail
+    void                touched_(long delta) {                  // node is modified, its size by
+                         for(Jnode * jn = this; jn != nullptr; jn = jn->parent_()) {
+                          jn->hash_ = 0;                        // delta: caches of the node and
+                          jn->stamp_ = 0;                       // its ancestors (only) follow
+                          if(jn->size_ != 0) jn->size_ = jn->size_ + delta;
+                         }
+                        }
+    void                touched_(void) {                        // modified, size change unknown:
+                         for(Jnode * jn = this; jn != nullptr; jn = jn->parent_()) {
+                          jn->hash_ = 0; jn->size_ = 0;         // caches of the node and its
+                          jn->stamp_ = 0;                       // ancestors (only) are voided
+                         }
+                        }
+    void                resized_(long delta)                    // node's value is replaced
+                         { if(parent_() != nullptr) parent_()->touched_(delta); }
+    void                sized_(size_t size) const { size_ = size; }
+    void                swap_(Jnode & jn) {                     // exchange values (w/o fixing
+                         using std::swap;                       // caches of ancestors)
+                         swap(type_, jn.type_);
+                         swap(value_, jn.value_);
+                         swap(descendants_, jn.descendants_);
+                         adopt_(jn);                            // children follow their holder
+                         jn.adopt_(*this);
+                         swap(hash_, jn.hash_);
+                         swap(size_, jn.size_);
+                         stamp_ = jn.stamp_ = 0;                // both are modified
+                        }
+    uint64_t            stamped_(void) const                    // stamp node (if not yet)
+                         { if(stamp_ == 0) stamp_ = ++stamps_; return stamp_; }
+    void                erase_(iter_jn it) {                    // erase child, maintain sizes
+                         long delta = -static_cast<long>(it->VALUE.size());
+                         children_().erase(it);
+                         value().touched_(delta);
+                        }
+  static uint64_t       hash_bytes_(const char *ptr, size_t len, uint64_t seed);
 
                         // Jnode data
     Jtype               type_{Object};
     std::string         value_;                                 // value (number/string/bool/null)
-    map_jn              descendants_;                           // array/nodes (objects)
+    std::shared_ptr<Kids>
+                        descendants_;                           // array/nodes (objects), shared
+    mutable Relaxed<uint64_t>
+                        hash_{0};                               // cached hash (0: not cached)
+    mutable Relaxed<size_t>
+                        size_{0};                               // cached size (0: not cached)
+    mutable Relaxed<uint64_t>
+                        stamp_{0};                              // search cache stamp (0: none)
+    Kids *              up_{nullptr};                           // children holding the node
 
  private:
   static std::ostream & print_json_(std::ostream & os, const Jnode & me, int & rl);
   static std::ostream & print_iterables_(std::ostream & os, const Jnode & me, int & rl);
 
-    static char         endl_;                                  // either for raw or pretty print
-    static uint8_t      tab_;                                   // tab size (for indention)
+                        // print settings are per thread (see "Thread safety" notes)
+    static thread_local char
+                        endl_;                                  // either for raw or pretty print
+    static thread_local uint8_t
+                        tab_;                                   // tab size (for indention)
+    static std::atomic<uint64_t>
+                        stamps_;                                // source of search cache stamps
+    static std::atomic<uint64_t>
+                        kids_;                                  // source of children ids
 };
 
 // class static definitions
-char Jnode::endl_{PRINT_PRT};                                   // default is pretty format
-uint8_t Jnode::tab_{3};
+thread_local char Jnode::endl_{PRINT_PRT};                      // default is pretty format
+thread_local uint8_t Jnode::tab_{3};
+std::atomic<uint64_t> Jnode::stamps_{0};
+std::atomic<uint64_t> Jnode::kids_{0};
 
 STRINGIFY(Jnode::ThrowReason, THROWREASON)
 #undef THROWREASON
@@ -1096,14 +1376,14 @@ class Jnode::Iterator: public std::iterator<std::bidirectional_iterator_tag, T>
 Jnode::iterator Jnode::begin(void) {
  if(is_atomic())
   throw EXP(type_non_iterable);
- return {children_().begin(), type()};
+ return {children_().begin(), value().type_};
 }
 
 
 Jnode::const_iterator Jnode::begin(void) const {
  if(is_atomic())
   throw EXP(type_non_iterable);
- return {children_().begin(), type()};
+ return {children_().begin(), value().type_};
 }
 
 
@@ -1114,14 +1394,14 @@ Jnode::const_iterator Jnode::cbegin(void) const
 Jnode::iterator Jnode::end(void) {
  if(is_atomic())
   throw EXP(type_non_iterable);
- return {children_().end(), type()};
+ return {children_().end(), value().type_};
 }
 
 
 Jnode::const_iterator Jnode::end(void) const {
  if(is_atomic())
   throw EXP(type_non_iterable);
- return {children_().end(), type()};
+ return {children_().end(), value().type_};
 }
 
 
@@ -1132,7 +1412,9 @@ Jnode::const_iterator Jnode::cend(void) const
 Jnode & Jnode::erase(iterator & it) {
  if(is_atomic())
   throw EXP(type_non_iterable);
+ long delta = -static_cast<long>(it.underlying_()->VALUE.size());
  it.underlying_() = children_().erase(it.underlying_());
+ value().touched_(delta);
  return *this;
 }
 
@@ -1140,7 +1422,9 @@ Jnode & Jnode::erase(iterator & it) {
 Jnode & Jnode::erase(const_iterator & it) {
  if(is_atomic())
   throw EXP(type_non_iterable);
+ long delta = -static_cast<long>(it.underlying_()->VALUE.size());
  it.underlying_() = children_().erase(it.underlying_());
+ value().touched_(delta);
  return *this;
 }
 
@@ -1148,7 +1432,9 @@ Jnode & Jnode::erase(const_iterator & it) {
 Jnode & Jnode::erase(const_iterator && it) {
  if(is_atomic())
   throw EXP(type_non_iterable);
+ long delta = -static_cast<long>(it.underlying_()->VALUE.size());
  children_().erase(it.underlying_());
+ value().touched_(delta);
  return *this;
 }
 
@@ -1163,28 +1449,28 @@ size_t Jnode::count(const std::string & l) const {
 Jnode::iterator Jnode::find(const std::string & l) {
  if(not is_object())
   throw EXP(expected_object_type);
- return {children_().find(l), type()};
+ return {children_().find(l), value().type_};
 }
 
 
 Jnode::const_iterator Jnode::find(const std::string & l) const {
  if(not is_object())
   throw EXP(expected_object_type);
- return {children_().find(l), type()};
+ return {children_().find(l), value().type_};
 }
 
 
 Jnode::iterator Jnode::find(size_t idx) {
  if(not is_iterable())
   throw EXP(type_non_iterable);
- return {iterator_by_idx_(idx), type()};
+ return {iterator_by_idx_(idx), value().type_};
 }
 
 
 Jnode::const_iterator Jnode::find(size_t idx) const {
  if(not is_iterable())
   throw EXP(type_non_iterable);
- return {iterator_by_idx_(idx), type()};
+ return {iterator_by_idx_(idx), value().type_};
 }
 
 
@@ -1240,6 +1526,79 @@ std::string Jnode::next_key_(void) const {
 }
 
 
+void Jnode::insert_(size_t idx, Jnode jn) {
+ // insert a node into array at the position idx (idx <= children()): array keys are kept
+ // (so that indexing remains direct), thus values of the tail are shifted - O(tail)
+ auto & ch = children_();
+ long delta = jn.size();
+ auto it = ch.emplace_hint(ch.end(), next_key_(), std::move(jn));   // append, then shift
+ for(auto at = idx + 1 < ch.size()? iterator_by_idx_(idx): it; it != at; --it)
+  it->VALUE.swap_(std::prev(it)->VALUE);
+ value().touched_(delta);
+}
+
+
+Jnode Jnode::extract_(size_t idx) {
+ // remove a node from array at the position idx and return it, values of the tail are shifted
+ auto & ch = children_();
+ auto it = iterator_by_idx_(idx);
+ for(auto next = std::next(it); next != ch.end(); ++it, ++next)  // shift the node to the end
+  it->VALUE.swap_(next->VALUE);
+ Jnode jn;
+ jn.swap_(it->VALUE);
+ ch.erase(it);
+ value().touched_(-static_cast<long>(jn.size()));
+ return jn;
+}
+
+
+Jnode Jnode::share(void) const {
+ // copy of the node sharing its children (the same as a copy: copies are copy-on-write)
+ return value();
+}
+
+
+uint64_t Jnode::hash(bool cached) const {
+ // structural hash: combines the type, atomic value, or otherwise labels (indices)
+ // and hashes of all children (in their order) - the same what operator== compares
+ auto & my = value();                                           // resolve if super node
+ if(my.is_atomic())
+  return hash_bytes_(my.value_.data(), my.value_.size(), my.type_ + 1);
+ uint64_t h = my.hash_;
+ if(cached and h != 0) return h;
+
+ h = hash_bytes_(nullptr, 0, my.type_ + 1);
+ for(auto & child: my.children_()) {
+  h = (h ^ hash_bytes_(child.KEY.data(), child.KEY.size(), h)) * 0x9E3779B97F4A7C15ull;
+  h = (h ^ child.VALUE.hash(cached)) * 0x9E3779B97F4A7C15ull;
+  h ^= h >> 32;
+ }
+ if(h == 0) h = 1;                                              // 0 is reserved for "not cached"
+ my.hash_ = h;
+ return h;
+}
+
+
+uint64_t Jnode::hash_bytes_(const char *ptr, size_t len, uint64_t seed) {
+ // a fast 64 bit hash of a byte string (MurmurHash64A style), processing 8 bytes at once
+ const uint64_t m = 0xC6A4A7935BD1E995ull;
+ uint64_t h = seed ^ (len * m);
+ for(; len >= 8; ptr += 8, len -= 8) {
+  uint64_t k;
+  memcpy(&k, ptr, 8);
+  k *= m; k ^= k >> 47; k *= m;
+  h ^= k; h *= m;
+ }
+ if(len > 0) {
+  uint64_t k = 0;
+  memcpy(&k, ptr, len);
+  h ^= k; h *= m;
+ }
+ h ^= h >> 47; h *= m; h ^= h >> 47;
+ return h;
+}
+
+
 std::ostream & Jnode::print_json_(std::ostream & os, const Jnode & me, int & rl) {
  auto & my = me.value();                                        // resolve if virtual object
  switch(my.type()) {
@@ -1323,6 +1682,21 @@ class Json{
                 keep_cache
     ENUM(CacheState, CACHE_STATE)
 
+    struct Reject {                                             // malformed record (parse_records)
+        size_t              offset;                             // record's offset in the input
+        size_t              error;                              // offset of the exception point
+        Jnode::ThrowReason  reason;
+        std::string         record;                             // text of the record
+    };
+
+    struct Limits {                                             // resource limits (0: no limit)
+        size_t              depth{0};                           // nesting of iterables
+        size_t              string{0};                          // characters in a string
+        size_t              number{0};                          // characters in a number
+        size_t              nodes{0};                           // values & labels in a document
+        size_t              regex{0};                           // steps per regex evaluation
+    };
+
 
                         Json(void) = default;
                         Json(const Jnode &jn): root_{jn.value()} { }
@@ -1333,6 +1707,9 @@ class Json{
     Jnode &             root(void) { return root_; }
     const Jnode &       root(void) const { return root_; }
     Json &              parse(const std::string & jstr);
+    Json &              parse_records(const std::string & jstr,
+                                      std::function<void(const Reject &)> reject,
+                                      std::function<void(const Jnode &)> accept = nullptr);
     std::string::const_iterator
                         exception_point(void) { return ep_; }
     class iterator;
@@ -1368,6 +1745,8 @@ class Json{
     bool                operator!=(const Json &j) const { return root() != j.root(); }
     bool                operator==(const Jnode &j) const { return root() == j; }
     bool                operator!=(const Jnode &j) const { return root() != j; }
+    uint64_t            hash(bool cached = true) const { return root().hash(cached); }
+    Json                share(void) const { return Json{root().share()}; }
     const std::string & str(void) const { return root().str(); }
     double              num(void) const { return root().num(); }
     bool                bul(void) const { return root().bul(); }
@@ -1404,11 +1783,13 @@ class Json{
     bool                is_solidus_quoted(void) const { return jsn_fbdn_[0] == '/'; }
     Json &              quote_solidus(bool quote)
                          { jsn_fbdn_ = quote? "/" JSN_FBDN: JSN_FBDN; return *this; }
+    bool                is_interning(void) const { return intern_; }
+    Json &              intern_subtrees(bool x = true) { intern_ = x; return *this; }
+    const Limits &      limits(void) const { return lim_; }
+    Json &              limits(const Limits & l) { lim_ = l; return *this; }
     Json &              clear_cache(void) { sc_.clear(); return *this; }
-
-    // calling clear_cache is required once JSON was modified anyhow; it's called
-    // anyway every time new walk is build, thus the end-user must call it only
-    // when continue walking iterators (with search iterators) past JSON modification
+    Json &              patch(const Jnode & ops);               // RFC 6902 JSON Patch
+    Json &              merge_patch(const Jnode & patch);       // RFC 7386 JSON Merge Patch
 
     //SERDES(root_)                                             // not really needed (so far)
     DEBUGGABLE()
@@ -1423,6 +1804,12 @@ class Json{
                         ep_;                                    // exception pointer
     const char *        jsn_fbdn_{JSN_FBDN};                    // JSN_FBDN pointer
     const char *        jsn_qtd_{JSN_QTD};                      // JSN_QTD pointer
+    bool                intern_{false};                         // share identical subtrees
+    std::unordered_multimap<uint64_t, Jnode>
+                        ipool_;                                 // interned subtrees (by hash)
+    Limits              lim_;                                   // resource limits
+    size_t              depth_{0};                              // nesting depth being parsed
+    size_t              nodes_{0};                              // nodes parsed (w/ nodes limit)
 
  private:
     // jsp: json string pointer
@@ -1433,6 +1820,12 @@ class Json{
     void                parse_array_(Jnode & node, std::string::const_iterator &jsp);
     void                parse_object_(Jnode & node, std::string::const_iterator &jsp);
     char                skip_blanks_(std::string::const_iterator & jsp);
+    void                intern_node_(Jnode & node);
+    std::string::const_iterator
+                        resync_(std::string::const_iterator jsp, const std::string & jstr,
+                                bool array) const;
+    bool                array_line_(std::string::const_iterator jsp,
+                                    const std::string & jstr) const;
     Jnode::Jtype        classify_jnode_(std::string::const_iterator & jsp);
     std::string::const_iterator &
                         find_delimiter_(char c, std::string::const_iterator & jsp);
@@ -1441,7 +1834,19 @@ class Json{
 
     typedef std::map<std::string, Jnode>::iterator iter_jn;
     typedef std::map<std::string, Jnode>::const_iterator const_iter_jn;
+    typedef Jnode::Kids kids;
     typedef std::vector<std::string> v_str;
+    typedef std::vector<std::function<void(void)>> v_undo;     // patch rollback actions
+
+    v_str               pointer_(const std::string & ptr) const;
+    size_t              patch_index_(const Jnode & ary, const std::string & tkn, bool append) const;
+    Jnode &             patch_node_(const v_str & path, size_t depth);
+    const Jnode &       patch_get_(const v_str & path) const;
+    void                patch_op_(const Jnode & op, v_undo & undo);
+    void                patch_add_(const v_str & path, Jnode jn, v_undo & undo);
+    Jnode               patch_remove_(const v_str & path, v_undo & undo);
+    void                patch_replace_(const v_str & path, Jnode jn, v_undo & undo);
+    void                merge_patch_(Jnode & target, const Jnode & patch);
 
     void                compile_walk_(const std::string & wstr, iterator & it) const;
     void                parse_lexemes_(const std::string & wstr, iterator & it) const;
@@ -1454,6 +1859,25 @@ class Json{
 
     // Properties and structures used by walk iterator:
 
+    // ReTraits:
+    // - regex traits counting evaluation steps: a regex compiled with `collate' flag
+    //   translates every character it compares, hence its steps could be bounded;
+    //   collation is kept to the plain char order, so ranges match as w/o the flag
+    struct ReTraits: std::regex_traits<char> {
+        struct Exhausted {};                                    // thrown once budget is spent
+        static size_t &     budget(void)                        // steps left (per thread)
+                             { static thread_local size_t b{SIZE_MAX}; return b; }
+        char                translate(char c) const
+                             { if(budget()-- == 0) throw Exhausted{}; return c; }
+        template<typename I>
+        std::string         transform(I first, I last) const {  // order as compared chars
+                             std::string s(first, last);
+                             if(std::is_signed<char>::value) for(auto & c: s) c ^= 0x80;
+                             return s;
+                            }
+    };
+    typedef std::basic_regex<char, ReTraits> Regex;
+
     // WalkStep:
     // - used by walk iterator and search cache key
     struct WalkStep {
@@ -1487,6 +1911,8 @@ class Json{
                             // stripped[0] -> a stripped lexeme (required)
                             // stripped[1] -> attached label match (optional)
         std::regex          re;
+        Regex               bre;                                // used instead, if bounded
+        bool                bounded{false};                     // regex steps limit applies
 
         COUTABLE(WalkStep, offset, init, search_type(), label(), lexeme)
     };
@@ -1501,14 +1927,19 @@ class Json{
         // of is_nested() and is_valid() methods
         // wsi (filled only when path is terminated with end() - out of iterations/non
         // iterable) used in increment_() facilitating walk path iterations
+        // kid is the id of children jit points into: once they get detached (copy-on-
+        // write), jit is re-resolved by lbl (see resolve_())
 
                             Itr(void) = default;                // for pv_.resize()
                             Itr(const iter_jn &it, const std::string &l, size_t i = 0):
                              jit(it), lbl(l), wsi(i) {}         // enable emplacement
+                            Itr(const iter_jn &it, const kids &k):
+                             jit(it), lbl(it->KEY), wsi(0), kid(k.id) {}
 
         iter_jn             jit;                                // iterator pointing to JSON
         std::string         lbl;                                // preserved label for validation
         size_t              wsi;                                // walk step index (for increments)
+        uint64_t            kid{0};                             // id of jit's children (0: end)
     };
 
     // Search Cache Key:
@@ -1535,6 +1966,14 @@ class Json{
 
     typedef std::vector<Itr> path_vector;                       // used by iterator
 
+    // Search Cache Entry:
+    // - paths to all matches, valid as long as the node (searched from) holds the same stamp
+    struct SearchCacheEntry {
+        uint64_t            stamp;                              // node's stamp when cached
+        std::vector<path_vector>
+                            paths;
+    };
+
     // parse_offset_type_() is dependent on WalkStep definition, hence moved down here
     void                parse_offset_type_(WalkStep & state) const;
 
@@ -1587,7 +2026,13 @@ class Json{
                                   throw EXP(index_request_for_non_array_enclosed);
                                  return std::stoul(lbl_->c_str(), nullptr, 16);
                                 }
-            Jnode &             value(void) { return *jnp_; }
+            Jnode &             value(void) {                   // access for modification:
+                                 if(jit_ != nullptr and jit_->resolve_(true)) { // own the path
+                                  lbl_ = &jit_->pv_.back().jit->KEY;
+                                  jnp_ = &jit_->pv_.back().jit->VALUE;
+                                 }
+                                 return *jnp_;
+                                }
             const Jnode &       value(void) const { return *jnp_; }
             bool                is_root(void) const { return &jit_->jp_->root() == jnp_; }
             Jnode &             operator[](long i) {
@@ -1597,12 +2042,14 @@ class Json{
                                  if(i >= 0) return Jnode::operator[](i);
                                  if(-i >= static_cast<s_long>(jit_->pv_.size()))
                                   return jit_->json_().root();
+                                 jit_->resolve_(true);
                                  return jit_->pv_[jit_->pv_.size() + i -1].jit->VALUE;
                                 }
             const Jnode &       operator[](long i) const {
                                  if(i >= 0) return Jnode::operator[](i);
                                  if(-i >= static_cast<s_long>(jit_->pv_.size()))
                                   return jit_->json_().root();
+                                 jit_->resolve_(false);
                                  return jit_->pv_[jit_->pv_.size() + i -1].jit->VALUE;
                                 }
             Jtype               parent_type(void) const { return type_; }
@@ -1643,21 +2090,30 @@ class Json{
                              return *this;
                             }
 
-                            // adapters to Jnode::iterator
+                            // adapters to Jnode::iterator (Jnode::iterator may modify
+                            // JSON, hence the path to it is owned)
                             operator Jnode::iterator (void) const {
-                             auto it = pv_.empty()?
-                                       jp_->root().children_().begin(): pv_.back().jit;
+                             auto & root = jp_->root();
+                             resolve_(true);
+                             auto it = pv_.empty()? root.children_().begin():
+                                       pv_.back().jit == nil_()? root.children_().end():
+                                       pv_.back().jit;
                              return Jnode::iterator{std::move(it), sn_.type_};
                             }
                             operator Jnode::const_iterator(void) const {
-                             auto it = pv_.empty()?
-                                       jp_->root().children_().begin(): pv_.back().jit;
+                             auto & root = jp_->root();
+                             resolve_(false);
+                             auto it = pv_.empty()? root.walk_children_().begin():
+                                       pv_.back().jit == nil_()? root.walk_children_().end():
+                                       pv_.back().jit;
                              return Jnode::const_iterator{std::move(it), sn_.type_};
                             }
 
         bool                operator==(const iterator & rhs) const {
                              if(pv_.empty()) return rhs.pv_.empty()? jp_ == rhs.jp_: false;
                              if(rhs.pv_.empty()) return false;
+                             if(pv_.back().jit != nil_() and rhs.pv_.back().jit != nil_())
+                              { resolve_(false); rhs.resolve_(false); }
                              return pv_.back().jit == rhs.pv_.back().jit;
                             }
         bool                operator!=(const iterator & rhs) const
@@ -1666,6 +2122,9 @@ class Json{
         bool                operator==(const T & rhs) const {   // Jnode::iterator comparator
                              if(pv_.empty()) return false;
                              // i.e. Jonde::iterator can never point to a root, hence always false
+                             if(pv_.back().jit == nil_())       // walk's end is root's end
+                              return jp_->root().walk_children_().end() == rhs.underlying_();
+                             resolve_(false);
                              return pv_.back().jit == rhs.underlying_();
                             }
         template<typename T>
@@ -1673,11 +2132,13 @@ class Json{
                              { return not operator==(rhs); }
 
         Jnode &             operator*(void) {
+                             resolve_(false);
                              return pv_.empty()?
                               sn_(jp_->root(), this):
                               sn_(pv_.back().jit->KEY, pv_.back().jit->VALUE, this);
                             }
         Jnode *             operator->(void) {
+                             resolve_(false);
                              return pv_.empty()?
                               &sn_(jp_->root(), this):
                               &sn_(pv_.back().jit->KEY, pv_.back().jit->VALUE, this);
@@ -1687,12 +2148,12 @@ class Json{
         iterator            end(void) const {
                              if(not jp_->root().is_iterable())
                               throw jp_->EXP(Jnode::walk_root_non_iterable);
-                             return iterator(jp_->root().children_().end());
+                             return iterator(nil_());
                             }
         bool                is_valid(void) const {
                              // end iterator is considered invalid path
                              if(pv_.empty()) return true;
-                             if(pv_.back().jit == jp_->root().children_().end()) return false;
+                             if(pv_.back().jit == nil_()) return false;
                              return is_valid_(jp_->root(), 0);
                             }
         bool                is_nested(iterator & it) const;
@@ -1725,11 +2186,14 @@ class Json{
 
       std::vector<WalkStep> ws_;                                // walk state vector (walk path)
         Json *              jp_;                                // json pointer (for json().end())
-        path_vector         pv_;                                // path_vector (result of walking)
+        mutable path_vector pv_;                                // path_vector (result of walking)
         SuperJnode          sn_{Jnode::Neither};                // super node's type_ holds parent's
 
      private:
         bool                is_valid_(Jnode & jnp, size_t idx) const;
+        bool                resolve_(bool modify) const;
+        static iter_jn      nil_(void)                          // end of any path
+                             { static kids none; return none.end(); }
         auto &              walk_path_(void) { return ws_; }
         const auto &        walk_path_(void) const { return ws_; }
         Json &              json_(void) const { return *jp_; }
@@ -1742,14 +2206,15 @@ class Json{
         void                walk_numeric_offset_(size_t wsi, Jnode *);
         void                walk_text_offset_(size_t wsi, Jnode *);
         void                walk_search_(size_t wsi, Jnode *);
-        void                search_all_(Jnode *, const char *, const
-                                        WalkStep &w, std::vector<path_vector> &);
-        bool                search_successful_(Jnode *, const char *lbl, const WalkStep &, long &);
-        void                lbl_callback_(const std::string &lbl, const Jnode *,
-                                          const std::vector<path_vector> * = nullptr);
+        bool                search_(Jnode *, const WalkStep &, long &,
+                                    std::vector<path_vector> * = nullptr);
+        void                next_sibling_(size_t base, Jnode *);
+        void                lbl_callback_(const std::string &lbl);
+        const std::string & parent_label_(void) const;
         void                itr_callback_(const Jnode *);
         bool                child_found_(Jnode *, const WalkStep &, long &);
         bool                label_matched_(const std::string &, const WalkStep &, long &) const;
+        bool                regex_search_(const std::string &, const WalkStep &) const;
         bool                atomic_matched_(const Jnode *, const char *l, const WalkStep &) const;
         bool                string_match_(const Jnode *, const char *lbl, const WalkStep &) const;
         bool                bull_matched_(const Jnode *, const char *lbl, const WalkStep &) const;
@@ -1763,7 +2228,7 @@ class Json{
 
     // data structures (cache storage and callbacks)
     // cache:
-    std::map<SearchCacheKey, std::vector<path_vector>, decltype(&SearchCacheKey::cmp)>
+    std::map<SearchCacheKey, SearchCacheEntry, decltype(&SearchCacheKey::cmp)>
                         sc_{SearchCacheKey::cmp};           // search cache itself
                         // search cache is the array of all path_vector's for given
                         // search key (combination of jnode and walk step)
@@ -1781,7 +2246,15 @@ class Json{
         std::function<void(const Jnode &)>
                             callback;
     };
-    typedef std::map<std::string, std::function<void(const Jnode &)>> lbl_callback_map;
+    struct LblCallback {
+     // label callback may be scoped: then it's invoked only for the labels found at the given
+     // depth and/or under the given parent label (the closest labeled ancestor)
+        size_t              depth;                          // 0: any, 1: root's children, ...
+        std::string         parent;                         // "": any parent
+        std::function<void(const Jnode &)>
+                            callback;
+    };
+    typedef std::map<std::string, std::vector<LblCallback>> lbl_callback_map;  // by bare label
     typedef std::vector<ItrCallback> itr_callback_vec;
 
     lbl_callback_map    lcb_;                               // label callbacks storage
@@ -1805,8 +2278,12 @@ class Json{
     Json &              engage_callbacks(bool x=true)           // engage/disengage all callbacks
                          { ce_ = x; return *this; };
     Json &              callback(const std::string &lbl,        // plug-in label-callback
+                                 std::function<void(const Jnode &)> &&cb)
+                         { return callback(lbl, 0, "", std::move(cb)); }
+    Json &              callback(const std::string &lbl,        // plug-in scoped label-callback
+                                 size_t depth, const std::string &parent,
                                  std::function<void(const Jnode &)> &&cb) {
-                         lcb_.emplace(std::move(lbl), std::move(cb));
+                         lcb_[lbl].push_back(LblCallback{depth, parent, std::move(cb)});
                          return *this;
                         }
     Json &              callback(iterator itr,                  // plug-in iter-callback
@@ -1850,15 +2327,135 @@ Json & Json::parse(const std::string & jstr) {
  root() = OBJ{};
 
  auto jsp = jstr.begin();                                       // json string pointer
- parse_(root_, jsp);
+ depth_ = nodes_ = 0;
+ try { parse_(root_, jsp); }
+ catch(...) { ipool_.clear(); throw; }
+ ipool_.clear();                                                // pool is needed only at parsing
 
- if(root_.type() == Jnode::Neither)
+ if(root_.type_ == Jnode::Neither)
   { ep_ = jsp; throw EXP(Jnode::expected_json_value); }
 
  return *this;
 }
 
 
+Json & Json::parse_records(const std::string & jstr,
+                           std::function<void(const Reject &)> reject,
+                           std::function<void(const Jnode &)> accept) {
+ // parse input made of records: either a top-level array of records, or otherwise
+ // a sequence of documents (e.g. NDJSON); records are collected into the root array, while
+ // a malformed record is passed to reject() and parsing resumes at the next record
+ // boundary: the next array element, or the next line (in a sequence) respectively;
+ // an array closed on its first line and followed by more input starts a sequence (e.g.
+ // NDJSON of arrays), input following the records array is read as a sequence too
+ root() = ARY{};
+ auto jsp = jstr.cbegin();
+ auto skip = [&jsp, &jstr] {                                    // skip blanks, not throwing
+              while(jsp != jstr.cend() and (*jsp == ' ' or *jsp == '\t' or
+                                            *jsp == CHR_EOL or *jsp == CHR_RTRN)) ++jsp;
+              return jsp == jstr.cend()? CHR_NULL: *jsp;
+             };
+ bool array = skip() == JSN_ARY_OPN and not array_line_(jsp, jstr);
+ if(array) ++jsp;
+
+ try {
+  for(char c = skip(); jsp != jstr.cend(); c = skip()) {
+   if(array and c == JSN_ARY_CLS)                               // records array is closed,
+    { ++jsp; array = false; continue; }                         // what follows is a sequence
+   auto rsp = jsp;                                              // record's start pointer
+   try {
+    Jnode rec;
+    depth_ = nodes_ = 0;                                        // limits apply per record
+    parse_(rec, jsp);
+    if(rec.type_ == Jnode::Neither) { ep_ = jsp; throw EXP(Jnode::expected_json_value); }
+    if(array and skip() != JSN_ARY_CLS and jsp != jstr.cend()) {   // expect ',' or ']'
+     if(*jsp != JSN_ASPR) { ep_ = jsp; throw EXP(Jnode::expected_enumeration); }
+     ++jsp;
+    }
+    if(accept) accept(rec);
+    root().push_back(std::move(rec));
+   }
+   catch(stdException & e) {
+    DBG(0) DOUT() << "rejecting record at " << rsp - jstr.cbegin() << ": " << e.what() << std::endl;
+    jsp = resync_(rsp, jstr, array);
+    reject(Reject{static_cast<size_t>(rsp - jstr.cbegin()),
+                  static_cast<size_t>(ep_ - jstr.cbegin()),
+                  static_cast<Jnode::ThrowReason>(e.code()), std::string{rsp, jsp}});
+    if(array and jsp != jstr.cend() and *jsp == JSN_ASPR) ++jsp;
+   }
+  }
+ }
+ catch(...) { ipool_.clear(); throw; }                          // reject() may throw
+ ipool_.clear();
+ return *this;
+}
+
+
+std::string::const_iterator
+Json::resync_(std::string::const_iterator jsp, const std::string & jstr, bool array) const {
+ // find the next record boundary: in a sequence - the line following the record's start,
+ // unless the record spans lines: then the line following the exception point, or the
+ // exception point's line, if it fails at a value opening the line (i.e. the record is
+ // truncated and the line starts a next one); in array - a comma (or the closing bracket)
+ // outside of nested iterables and strings (JSON string cannot span lines, thus a new line
+ // closes any open string)
+ if(not array) {
+  auto eol = std::find(jsp, jstr.cend(), CHR_EOL);
+  if(eol == jstr.cend() or ep_ <= eol) return eol == jstr.cend()? eol: eol + 1;
+  auto bol = ep_;                                               // record spans lines
+  while(bol[-1] == ' ' or bol[-1] == '\t') --bol;
+  if(bol[-1] == CHR_EOL and ep_ != jstr.cend() and (*ep_ == JSN_OBJ_OPN or *ep_ == JSN_ARY_OPN))
+   return bol;                                                  // a truncated record
+  eol = std::find(ep_, jstr.cend(), CHR_EOL);
+  return eol == jstr.cend()? eol: eol + 1;
+ }
+
+ bool quoted = false;
+ for(int depth = 0; jsp != jstr.cend(); ++jsp) {
+  if(quoted) {
+   if(*jsp == '\\' and jsp + 1 != jstr.cend() and jsp[1] != CHR_EOL) ++jsp;
+   else if(*jsp == JSN_STRQ or *jsp == CHR_EOL) quoted = false;
+   continue;
+  }
+  switch(*jsp) {
+   case JSN_STRQ: quoted = true; break;
+   case JSN_OBJ_OPN:
+   case JSN_ARY_OPN: ++depth; break;
+   case JSN_OBJ_CLS: if(depth > 0) --depth; break;              // stray '}' is ignored
+   case JSN_ARY_CLS: if(depth-- == 0) return jsp; break;        // end of records array
+   case JSN_ASPR: if(depth == 0) return jsp; break;
+  }
+ }
+ return jsp;
+}
+
+
+bool Json::array_line_(std::string::const_iterator jsp, const std::string & jstr) const {
+ // check if array opening at jsp is closed on the same line and more input follows it,
+ // i.e. input is a sequence of arrays (e.g. NDJSON) rather than an array of records
+ bool quoted = false;
+ for(int depth = 0; jsp != jstr.cend() and *jsp != CHR_EOL; ++jsp) {
+  if(quoted) {
+   if(*jsp == '\\' and jsp + 1 != jstr.cend() and jsp[1] != CHR_EOL) ++jsp;
+   else if(*jsp == JSN_STRQ) quoted = false;
+   continue;
+  }
+  switch(*jsp) {
+   case JSN_STRQ: quoted = true; break;
+   case JSN_OBJ_OPN:
+   case JSN_ARY_OPN: ++depth; break;
+   case JSN_OBJ_CLS:
+   case JSN_ARY_CLS:
+        if(--depth > 0) break;
+        return std::find_if(jsp + 1, jstr.cend(), [](char c)
+                             { return c != ' ' and c != '\t' and c != CHR_EOL and c != CHR_RTRN; })
+               != jstr.cend();
+  }
+ }
+ return false;
+}
+
+
 void Json::parse_(Jnode & node, std::string::const_iterator &jsp) {
  // parse JSON from string
  skip_blanks_(jsp);
@@ -1874,9 +2471,14 @@ void Json::parse_(Jnode & node, std::string::const_iterator &jsp) {
  }
 
  if(node.type_ == Jnode::Neither) return;
- DBG(5) DOUT() << "classified as: " << ENUMS(Jnode::Jtype, node.type()) << std::endl;
-
- switch(node.type()) {
+ DBG(5) DOUT() << "classified as: " << ENUMS(Jnode::Jtype, node.type_) << std::endl;
+ if(lim_.nodes != 0 and ++nodes_ > lim_.nodes)
+  { ep_ = jsp; throw EXP(Jnode::limit_nodes_exceeded); }
+ if(lim_.depth != 0 and node.is_iterable() and depth_ >= lim_.depth)
+  { ep_ = jsp; throw EXP(Jnode::limit_depth_exceeded); }
+
+ ++depth_;
+ switch(node.type_) {
   case Jnode::Object: parse_object_(node, ++jsp); break;        // skip '{' with ++jsp
   case Jnode::Array: parse_array_(node, ++jsp); break;          // skip '[' with ++jsp
   case Jnode::String: parse_string_(node, ++jsp); break;        // skip '"' with ++jsp
@@ -1885,6 +2487,21 @@ void Json::parse_(Jnode & node, std::string::const_iterator &jsp) {
   case Jnode::Null: jsp += 4; break;                            // leave node blank, skip "null"
   default: break;                                               // covering warning of the compiler
  }
+ --depth_;
+ if(intern_ and node.has_children()) intern_node_(node);
+}
+
+
+void Json::intern_node_(Jnode & node) {
+ // hash-consing: share children of the node with an identical (already parsed) subtree;
+ // children are interned before their parent, hence comparing subtrees is O(children)
+ auto range = ipool_.equal_range(node.hash());
+ for(auto it = range.first; it != range.second; ++it)
+  if(it->second == node) {
+   node.descendants_ = it->second.descendants_;                 // copy-on-write will detach it
+   return;
+  }
+ ipool_.emplace(node.hash(), node.share());
 }
 
 
@@ -1917,11 +2534,12 @@ void Json::parse_number_(Jnode & node, std::string::const_iterator &jsp) {
 
 void Json::parse_array_(Jnode & node, std::string::const_iterator &jsp) {
  // parse elements of JSON Array (recursively)
- for(bool comma_read = false; true;) {
+ size_t size = 1;                                               // node's size is cached while
+ for(bool comma_read = false; true;) {                          // parsing
   Jnode child;
   parse_(child, jsp);
 
-  if(child.type() == Jnode::Neither) {
+  if(child.type_ == Jnode::Neither) {
    if(*jsp == JSN_ARY_CLS) {
     if(node.empty()) { ++jsp; return; }                         // empty array: [ ]
     if(not comma_read) { ++jsp; return; }                       // end of array: ..., "last" ]
@@ -1935,7 +2553,9 @@ void Json::parse_array_(Jnode & node, std::string::const_iterator &jsp) {
   if(not comma_read and node.has_children())                    // e.g.: [ "abc" 3.14 ]
    { ep_ = jsp; throw EXP(Jnode::expected_enumeration); }
 
+  size += child.size();
   node.children_().emplace(node.next_key_(), std::move(child));
+  node.sized_(size);
   comma_read = false;
  }
 }
@@ -1943,6 +2563,7 @@ void Json::parse_array_(Jnode & node, std::string::const_iterator &jsp) {
 
 void Json::parse_object_(Jnode & node, std::string::const_iterator &jsp) {
  // parse elements of JSON Object (recursively)
+ size_t size = 1;
  for(bool comma_read = false; true;) {
   skip_blanks_(jsp);
   auto lsp = jsp;                                               // label's begin pointer
@@ -1950,7 +2571,7 @@ void Json::parse_object_(Jnode & node, std::string::const_iterator &jsp) {
   Jnode label;
   parse_(label, jsp);                                           // must be a string (label)
   if(not label.is_string()) {
-   if(label.type() == Jnode::Neither) {                         // parsing of label failed
+   if(label.type_ == Jnode::Neither) {                         // parsing of label failed
     if(*jsp == JSN_OBJ_CLS) {
      if(node.empty()) { ++jsp; return; }                        // empty object: { }
      if(not comma_read) { ++jsp; return; }                      // end of object: ..."last" }
@@ -1967,13 +2588,16 @@ void Json::parse_object_(Jnode & node, std::string::const_iterator &jsp) {
 
   Jnode child;
   parse_(child, ++jsp);
-  if(child.type() == Jnode::Neither)                            // after 'label:' there must follow
+  if(child.type_ == Jnode::Neither)                             // after 'label:' there must follow
    { ep_ = jsp; throw EXP(Jnode::expected_json_value); }        // a valid JSON value
 
   if(not comma_read and node.has_children())                    // e.g.: [ "abc" 3.14 ]
    { ep_ = jsp; throw EXP(Jnode::expected_enumeration); }
 
-  node.children_().emplace(std::move(label.str()), std::move(child));
+  size_t child_size = child.size();
+  if(node.children_().emplace(std::move(label.str()), std::move(child)).second)
+   size += child_size;                                          // duplicate label is dropped
+  node.sized_(size);
   comma_read = false;
  }
 }
@@ -1981,7 +2605,10 @@ void Json::parse_object_(Jnode & node, std::string::const_iterator &jsp) {
 
 std::string::const_iterator & Json::find_delimiter_(char c, std::string::const_iterator & jsp) {
  // find next occurrence of character (actually it's used only to find `"')
+ size_t left = lim_.string == 0? SIZE_MAX: lim_.string;         // characters left till limit
  while(*jsp != c) {
+  if(left-- == 0)
+   { ep_ = jsp; throw EXP(Jnode::limit_string_exceeded); }
   if(*jsp AMONG(CHR_NULL, CHR_EOL))                             // JSON string does not support
    { ep_ = jsp; throw EXP(Jnode::unexpected_end_of_line); }     // multiline, hence throwing
   if(strchr(jsn_fbdn_, *jsp) != nullptr)                        // i.e. found illegal JSON control
@@ -2002,8 +2629,11 @@ std::string::const_iterator & Json::find_delimiter_(char c, std::string::const_i
 
 std::string::const_iterator & Json::validate_number_(std::string::const_iterator & jsp) {
  // wrapper for static json_number_definition()
+ auto sp = jsp;
  if(json_number_definition(jsp) != Jnode::Number)               // failed to convert
   { ep_ = jsp; throw EXP(Jnode::invalid_number); }
+ if(lim_.number != 0 and static_cast<size_t>(jsp - sp) > lim_.number)
+  { ep_ = sp + lim_.number; throw EXP(Jnode::limit_number_exceeded); }
  return jsp;
 }
 
@@ -2145,7 +2775,7 @@ Json::iterator Json::walk(const std::string & wstr, CacheState action) {
 
  it.walk_();
  if(it.pv_.empty()) return itr;                                 // must resolve reference
- if(it.pv_.back().jit != root().children_().end()) return itr;  // must resolve reference
+ if(it.pv_.back().jit != iterator::nil_()) return itr;         // must resolve reference
  // here walk_() returned end(), but it might not be a true end, an increment step is required
  // in order to confirm that it's either a true end; return then incremented reference
  it.pv_.clear();                                                // here walk_() returned end(), so
@@ -2243,8 +2873,13 @@ void Json::parse_suffix_(std::string::const_iterator &si, iterator & it, v_str &
  Jsearch sfx = search_suffix_(*si);                             // see if a search suffix valid
  if(sfx < end_of_match) {
   last_step.jsearch = sfx;
-  if(sfx AMONG(Regex_search, Label_RE_search, Ditital_regex))
-   last_step.re = last_step.stripped.front();                   // it's a RE, book RE then
+  if(sfx AMONG(Regex_search, Label_RE_search, Ditital_regex)) {
+   last_step.bounded = lim_.regex != 0;                         // it's a RE, book RE then
+   if(last_step.bounded)                                        // (counting steps if limited)
+    last_step.bre.assign(last_step.stripped.front(), std::regex::ECMAScript | std::regex::collate);
+   else
+    last_step.re.assign(last_step.stripped.front(), std::regex::ECMAScript);
+  }
   DBG(1) DOUT() << "search type sfx: " << ENUMS(Jsearch, sfx) << std::endl;
 
   if(last_step.stripped.front().empty())                        // i.e. search is "<>Sfx"
@@ -2338,7 +2973,7 @@ void Json::parse_offset_type_(WalkStep & ws) const {
 bool Json::iterator::is_nested(iterator & it) const {
  // check if we're nesting iterator. end() iterator considered to be non-nested
  if(pv_.empty()) return true;                                   // root always nest
- if(pv_.back().jit == jp_->root().children_().end())
+ if(pv_.back().jit == nil_())
   return false;
  for(size_t i = 0; i<pv_.size() and i<it.pv_.size(); ++i)
   if(pv_[i].lbl != it.pv_[i].lbl)
@@ -2347,12 +2982,32 @@ bool Json::iterator::is_nested(iterator & it) const {
 }
 
 
+bool Json::iterator::resolve_(bool modify) const {
+ // once children on the path were detached (copy-on-write) since walked, re-resolve the path
+ // in the walked JSON by the preserved labels; if modify, the path is detached (owned) too.
+ // return true if the path leads to a JSON node (end() and root are not resolved)
+ Jnode * jn = & json_().root();
+ for(auto & itr: pv_) {
+  if(itr.jit == nil_()) return false;
+  auto & kids = modify? jn->children_(): jn->walk_children_();
+  if(kids.id != itr.kid) {                                      // children were detached
+   auto found = kids.find(itr.lbl);
+   if(found == kids.end()) return false;                        // the path is no more
+   itr.jit = found;
+   itr.kid = kids.id;
+  }
+  jn = & itr.jit->VALUE;
+ }
+ return not pv_.empty();
+}
+
+
 bool Json::iterator::is_valid_(Jnode & jn, size_t idx) const {
  // check if all labels in path-vector are present
  if(idx >= pv_.size())
   return true;
- auto it = jn.children_().find(pv_[idx].lbl);
- if(it != jn.children_().end())
+ auto it = jn.walk_children_().find(pv_[idx].lbl);
+ if(it != jn.walk_children_().end())
   return is_valid_(it->VALUE, idx+1);
  return false;
 }
@@ -2369,7 +3024,7 @@ Json::iterator & Json::iterator::walk_(void) {
   if(pv_.empty())
    jnp = & json_().root();
   else {
-   if(pv_.back().jit == json_().root().children_().end())
+   if(pv_.back().jit == nil_())
     { DBG(json_(), 2) show_built_pv_(DOUT(json_())); return *this; }
    jnp = &pv_.back().jit->VALUE;
   }
@@ -2377,10 +3032,10 @@ Json::iterator & Json::iterator::walk_(void) {
  }
 
  if(pv_.empty())
-  cnt_type_() = jp_->root().type();
+  cnt_type_() = jp_->root().type_;
  else
-  if(pv_.back().jit != json_().root().children_().end())
-   cnt_type_() = pv_.size()>1? pv_[pv_.size()-2].jit->VALUE.type(): jp_->type();
+  if(pv_.back().jit != nil_())
+   cnt_type_() = pv_.size()>1? pv_[pv_.size()-2].jit->VALUE.type_: jp_->root().type_;
  DBG(json_(), 2) DOUT(json_()) << "finished walking" << std::endl;
  return *this;
 }
@@ -2390,7 +3045,7 @@ void Json::iterator::show_built_pv_(std::ostream &out) const {
  out << "built path vector:";
  for(auto &it: pv_)
   out << (&it == &pv_.front()? " ":"-> ")
-      << (it.jit == json_().root().children_().end()? "(end)": it.lbl);
+      << (it.jit == nil_()? "(end)": it.lbl);
  out << std::endl;
 }
 
@@ -2419,10 +3074,11 @@ void Json::iterator::walk_numeric_offset_(size_t idx, Jnode *jn) {
  }
 
  if(ws.offset >= 0) {                                           // [0], [+1], etc
-  if(ws.offset >= static_cast<s_long>(jn->children_().size()))  // address beyond children's size
-   { pv_.emplace_back(json_().root().children_().end(), "", idx); return; }
-  auto it = jn->iterator_by_idx_(ws.offset);
-  pv_.emplace_back(it, it->KEY);
+  auto & kids = jn->walk_children_();
+  if(ws.offset >= static_cast<s_long>(kids.size()))             // offset beyond children
+   { pv_.emplace_back(nil_(), "", idx); return; }
+  auto it = static_cast<const Jnode *>(jn)->iterator_by_idx_(ws.offset);  // walk is read-only
+  pv_.emplace_back(reinterpret_cast<const iter_jn &>(it), kids);
   return;
  }
 
@@ -2434,11 +3090,12 @@ void Json::iterator::walk_numeric_offset_(size_t idx, Jnode *jn) {
 void Json::iterator::walk_text_offset_(size_t idx, Jnode *jn) {
  // walk a text offset, e.g.: [label]
  auto &ws = ws_[idx];
- auto it = jn->children_().find(ws.stripped.front());           // see if label exist
- if(it == jn->children_().end())
-  pv_.emplace_back(json_().root().children_().end(), "", idx);
+ auto & kids = jn->walk_children_();
+ auto it = kids.find(ws.stripped.front());                      // see if label exist
+ if(it == kids.end())
+  pv_.emplace_back(nil_(), "", idx);
  else
-  pv_.emplace_back(it, it->KEY);                                // if so, add to the path-vector
+  pv_.emplace_back(it, kids);                                   // if so, add to the path-vector
 }
 
 
@@ -2449,108 +3106,125 @@ void Json::iterator::walk_search_(size_t idx, Jnode *jn) {
 
  if(ws.lexeme.front() == LXM_SCH_CLS) {                         // '>': search immediate children
   if(not child_found_(jn, ws, i))
-   pv_.emplace_back(json_().root().children_().end(), "", idx);
+   pv_.emplace_back(nil_(), "", idx);
   return;
  }
 
  if(ws.init < 0) {                                              // non-iterable, find once
-  if(not search_successful_(jn, nullptr, ws, i))
-   pv_.emplace_back(json_().root().children_().end(), "", idx);
+  if(not search_(jn, ws, i))
+   pv_.emplace_back(nil_(), "", idx);
   return;
  }
 
  auto & cache = cache_();                                       // search is iterable: build cache
- SearchCacheKey skey{jn, ws};
- if(cache.count(skey) == 0) {                                   // cache does not exits
-  DBG(json_(), 1) DOUT(json_()) << skey << std::endl;
-  cache[skey].resize(1);                                        // prepare place for 1st pathvector
-  search_all_(jn, nullptr, ws, cache[skey]);                    // build cache
-  cache[skey].pop_back();                                       // last entry is redundant
-  DBG(json_(), 1) DOUT(json_()) << "cached " << cache[skey].size() << " searches" << std::endl;
+ auto & entry = cache[SearchCacheKey{jn, ws}];
+ if(entry.stamp == 0 or entry.stamp != jn->stamp_) {           // cache does not exist or stale
+  DBG(json_(), 1) DOUT(json_()) << SearchCacheKey{jn, ws} << std::endl;
+  entry.paths.clear();
+  entry.stamp = jn->stamped_();                                 // stamp first: callbacks may reuse
+  search_(jn, ws, i, &entry.paths);                             // build cache
+  DBG(json_(), 1) DOUT(json_()) << "cached " << entry.paths.size() << " searches" << std::endl;
  }
 
- if(i >= static_cast<s_long>(cache[skey].size()))               // offset outside of cache:
-  pv_.emplace_back(json_().root().children_().end(), "", idx);  // return end() iterator
+ if(i >= static_cast<s_long>(entry.paths.size()))               // offset outside of cache:
+  pv_.emplace_back(nil_(), "", idx);                            // return end() iterator
  else                                                           // otherwise augment the path
-  for(auto &path: cache[skey][i])
+  for(auto &path: entry.paths[i])
    pv_.push_back(path);
 }
 
 
-void Json::iterator::search_all_(Jnode *jn, const char *lbl,
-                       const WalkStep &ws, std::vector<path_vector> & vpv) {
- // find all matches from given json node, cache them into current vector of paths:
- // cache is the vector of all found path-vectors
- if(jn->is_iterable()) {
-  for(auto it = jn->children_().begin(); it != jn->children_().end(); ++it) {
-   vpv.back().emplace_back(it, it->KEY);
-   if(json_().callbacks_engaged(iterator_based))
-    itr_callback_(jn);
-   if(jn->is_object()) {
-    if(json_().callbacks_engaged(label_based))
-     lbl_callback_(it->KEY, jn, &vpv);
-    if(ws.jsearch AMONG(label_match, Label_RE_search)) {
-     long i = 0;
-     if(label_matched_(it->KEY, ws, i)) vpv.push_back(vpv.back());  // if found, preserve path
-    }
+bool Json::iterator::search_(Jnode *jn, const WalkStep &ws, long &i,
+                             std::vector<path_vector> *vpv) {
+ // search Jnode tree (in pre-order) from given node: if vpv is given, then find all matches
+ // and cache their paths (relative to jn) into vpv, otherwise search until i-th match is
+ // found and return true/false - if found, pv_ is augmented with the path to the match
+ // the search is iterative: pv_ serves both as the traversal stack and as the current
+ // path (so that label callbacks see the current path as is)
+ size_t base = pv_.size();
+ auto matched = [&](void) {                                     // pv_ beyond base is a match
+                 if(vpv == nullptr) return --i < 0;
+                 vpv->emplace_back(pv_.begin() + base, pv_.end());
+                 return false;
+                };
+
+ if(jn->is_atomic()) {                                          // search of a single node
+  if(json_().callbacks_engaged(iterator_based))
+   itr_callback_(jn);
+  return atomic_matched_(jn, nullptr, ws)? matched(): false;
+ }
+ auto & kids = jn->walk_children_();
+ if(kids.empty()) return false;
+ pv_.emplace_back(kids.begin(), kids);
+
+ while(pv_.size() > base) {                                     // pv_.back() is a visited child
+  Jnode *parent = pv_.size() - 1 == base? jn: &pv_[pv_.size() - 2].jit->VALUE;
+  auto it = pv_.back().jit;
+  if(json_().callbacks_engaged(iterator_based))
+   itr_callback_(parent);
+  if(parent->is_object()) {
+   if(json_().callbacks_engaged(label_based))
+    lbl_callback_(it->KEY);
+   if(ws.jsearch AMONG(label_match, Label_RE_search)) {
+    long li = 0;
+    if(label_matched_(it->KEY, ws, vpv == nullptr? i: li) and
+       (vpv == nullptr or matched())) return true;
    }
-   search_all_(&it->VALUE, jn->is_object()? it->KEY.c_str(): nullptr, ws, vpv);
-   vpv.back().pop_back();
   }
-  return;
+
+  Jnode &child = it->VALUE;
+  if(child.is_iterable()) {                                     // descend into child
+   auto & kids = child.walk_children_();
+   if(not kids.empty())
+    { pv_.emplace_back(kids.begin(), kids); continue; }
+  }
+  else {
+   if(json_().callbacks_engaged(iterator_based))
+    itr_callback_(&child);
+   if(atomic_matched_(&child, parent->is_object()? it->KEY.c_str(): nullptr, ws) and
+      matched()) return true;
+  }
+  next_sibling_(base, jn);
  }
- // it's atomic then
- if(json_().callbacks_engaged(iterator_based))
-  itr_callback_(jn);
- if(atomic_matched_(jn, lbl, ws))                               // if mathed
-  vpv.push_back(vpv.back());                                    // preserve the path then
+ return false;
 }
 
 
-
-bool Json::iterator::search_successful_(Jnode *jn, const char *lbl, const WalkStep &ws, long &i) {
- // search current Jnode tree forward, return true/false if found,
- // if found pv_.back() must contain an iterator to the found node
- if(jn->is_iterable()) {
-  for(auto it = jn->children_().begin(); it != jn->children_().end(); ++it) {
-   pv_.emplace_back(it, it->KEY);
-   if(json_().callbacks_engaged(iterator_based))
-    itr_callback_(jn);
-   if(jn->is_object()) {
-    if(json_().callbacks_engaged(label_based))
-     lbl_callback_(it->KEY, jn);
-    if(ws.jsearch AMONG(label_match, Label_RE_search))
-     if(label_matched_(it->KEY, ws, i)) return true;
-   }
-   if(search_successful_(&it->VALUE, jn->is_object()? it->KEY.c_str(): nullptr, ws, i))
-    return true;
-   pv_.pop_back();
-  }
-  return false;
+void Json::iterator::next_sibling_(size_t base, Jnode *jn) {
+ // advance pv_.back() to the next sibling, popping exhausted levels (down to base)
+ while(pv_.size() > base) {
+  Jnode *parent = pv_.size() - 1 == base? jn: &pv_[pv_.size() - 2].jit->VALUE;
+  auto & itr = pv_.back();
+  if(++itr.jit != parent->walk_children_().end())
+   { itr.lbl = itr.jit->KEY; return; }
+  pv_.pop_back();
  }
- // it's not iterable
- if(json_().callbacks_engaged(iterator_based))
-  itr_callback_(jn);
- if(not atomic_matched_(jn, lbl, ws)) return false;
- return --i < 0? true: false;
 }
 
 
 
-void Json::iterator::lbl_callback_(const std::string &label, const Jnode *jn,
-                               const std::vector<path_vector> *vpv) {
- // invoke callback attached to the label (if there's one)
- if(json_().lbl_callbacks().count(label) == 0) return;          // label not registered?
+void Json::iterator::lbl_callback_(const std::string &label) {
+ // invoke callbacks attached to the label (if there are), whose scope matches the path in pv_
+ auto found = json_().lbl_callbacks().find(label);
+ if(found == json_().lbl_callbacks().end()) return;             // label not registered?
+ for(auto & lc: found->second) {
+  if(lc.depth != 0 and lc.depth != pv_.size()) continue;        // out of scope
+  if(not lc.parent.empty() and lc.parent != parent_label_()) continue;
 
- if(vpv != nullptr)                                             // callback from search_all_()
-  for(auto &path: vpv->back())                                  // then need to augment path-vector
-   pv_.push_back(path);                                         // from last vpv path
+  cnt_type_() = Jnode::Object;                                  // ensure supernode's correct type
+  lc.callback( operator*() );                                   // call back passing super node
+ }
+}
 
- cnt_type_() = Jnode::Object;                                   // ensure supernode's correct type
- json_().lbl_callbacks()[label]( operator*() );                 // call back passing super node
 
- if(vpv != nullptr)
-  pv_.resize(pv_.size() - vpv->back().size());                  // restore path
+const std::string & Json::iterator::parent_label_(void) const {
+ // return label of the closest labeled ancestor of pv_.back() (i.e. skipping arrays)
+ static const std::string none;
+ for(size_t i = pv_.size() - 1; i-- > 0;) {                     // pv_[i] is an ancestor
+  const Jnode & parent = i == 0? json_().root(): pv_[i - 1].jit->VALUE;
+  if(parent.is_object()) return pv_[i].lbl;
+ }
+ return none;
 }
 
 
@@ -2559,7 +3233,8 @@ void Json::iterator::itr_callback_(const Jnode *jn) {
  // invoke callbacks matching given iterator
  for(auto &ic: json_().itr_callbacks()) {
   if(ic.iter == ic.iter.end()) continue;                        // iterations are over
-  if(&ic.iter->value() != jn) continue;                         // it's a different node
+  const Jnode & node = *ic.iter;                                // const: must not detach
+  if(&node.value() != jn) continue;                             // it's a different node
 
   ic.callback( *ic.iter );                                      // call back passing super node
   json_().engage_callbacks(false);
@@ -2576,17 +3251,18 @@ bool Json::iterator::child_found_(Jnode *jn, const WalkStep &ws, long &i) {
  if(not jn->is_iterable())                                      // only iterables have children
   return false;
 
- for(auto it = jn->children_().begin(); it != jn->children_().end(); ++it) {
+ auto & kids = jn->walk_children_();
+ for(auto it = kids.begin(); it != kids.end(); ++it) {
   if(jn->is_object() and (ws.jsearch AMONG(label_match, Label_RE_search))) {
    if(label_matched_(it->KEY, ws, i)) {
-    pv_.emplace_back(jn->children_().find(it->KEY), it->KEY);
+    pv_.emplace_back(it, kids);
     return true;
    }
    continue;
   }
   if(it->VALUE.is_atomic())                                     // try to match str/num/bool/null
    if(atomic_matched_(&it->VALUE, it->KEY.c_str(), ws) and --i < 0) {
-    pv_.emplace_back(jn->children_().find(it->KEY), it->KEY);
+    pv_.emplace_back(it, kids);
     return true;
    }
  }
@@ -2599,11 +3275,28 @@ bool Json::iterator::label_matched_(const std::string &lbl, const WalkStep &ws,
   if(lbl != ws.stripped.front()) return false;
   return --i < 0? true: false;
  }
- if(not std::regex_search(lbl, ws.re)) return false;            // ws.jsearch == Label_RE_match
+ if(not regex_search_(lbl, ws)) return false;                   // ws.jsearch == Label_RE_match
  return --i < 0? true: false;
 }
 
 
+bool Json::iterator::regex_search_(const std::string &str, const WalkStep &ws) const {
+ // regex search, bounded by the regex steps limit (when given)
+ if(not ws.bounded) return std::regex_search(str, ws.re);
+
+ size_t steps = json_().lim_.regex;
+ ReTraits::budget() = steps == 0? SIZE_MAX: steps;
+ try {
+  bool found = std::regex_search(str, ws.bre);
+  ReTraits::budget() = SIZE_MAX;
+  return found;
+ }
+ catch(ReTraits::Exhausted &) { ReTraits::budget() = SIZE_MAX; }
+ DBG(json_(), 0) DOUT(json_()) << "regex exceeded " << steps << " steps on: " << str << std::endl;
+ throw json_().EXP(Jnode::limit_regex_exceeded);
+}
+
+
 bool Json::iterator::atomic_matched_(const Jnode *jn, const char *lbl, const WalkStep &ws) const {
  // see if string/number/bool/null value matches
  if(ws.jsearch AMONG(regular_match, Regex_search, digital_match, Ditital_regex))
@@ -2624,7 +3317,7 @@ bool Json::iterator::string_match_(const Jnode *jn, const char *lbl, const WalkS
   case Ditital_regex:
         if(ws.stripped.size() > 1)                              // label present: try matching
          if(lbl == nullptr or ws.stripped.back() != lbl) return false;
-        return jn->is_number() and std::regex_search(jn->val(), ws.re);
+        return jn->is_number() and regex_search_(jn->val(), ws);
   case regular_match:
         if(ws.stripped.size() > 1)                              // label present: try matching
          if(lbl == nullptr or ws.stripped.back() != lbl) return false;
@@ -2632,7 +3325,7 @@ bool Json::iterator::string_match_(const Jnode *jn, const char *lbl, const WalkS
   case Regex_search:
         if(ws.stripped.size() > 1)                              // label present: try matching
          if(lbl == nullptr or ws.stripped.back() != lbl) return false;
-        return jn->is_string() and std::regex_search(jn->val(), ws.re);
+        return jn->is_string() and regex_search_(jn->val(), ws);
   default:                                                      // should never reach here.
         throw json_().EXP(Jnode::walk_a_bug);                   // covering compiler's warning
  }
@@ -2662,12 +3355,12 @@ bool Json::iterator::bull_matched_(const Jnode *jn, const char *lbl, const WalkS
 bool Json::iterator::incremented(void) {
  // produce a next iterator per walk string (this call is just a wrapper for increment_)
  if(not pv_.empty())
-  if(pv_.back().jit == json_().root().children_().end())        // don't attempt incrementing end()
+  if(pv_.back().jit == nil_())                                  // don't increment end()
    return false;
 
  long i = next_iterable_ws(walk_path_().size());
  if(i < 0) {
-  pv_.emplace_back(json_().root().children_().end(), "");
+  pv_.emplace_back(nil_(), "");
   DBG(json_(), 2) DOUT(json_()) << "path is non-iterable" << std::endl;
   return false;
  }
@@ -2684,7 +3377,7 @@ bool Json::iterator::increment_(long l) {
  DBG(json_(), 2) DOUT(json_()) << "next increment: [" << l << "] " << ws << std::endl;
  walk_();
  if(pv_.empty()) return true;                                   // successful walk
- if(pv_.back().jit != json_().root().children_().end()) return true;    // successful walk
+ if(pv_.back().jit != nil_()) return true;                     // successful walk
 
  // unsuccessful walk (out of iterations)
  if(l < static_cast<s_long>(pv_.back().wsi)) {                  // it's not my position, plus
@@ -2714,6 +3407,1030 @@ long Json::iterator::next_iterable_ws(long idx) const {
 
 
 
+//                      JSON Patch (RFC 6902) and JSON Merge Patch (RFC 7386)
+//
+// both are applied in place: nodes on the path to a patched location are accessed for
+// modification (their cached hashes, sizes and search stamps are invalidated), while
+// the rest of the document (and its cached data) stays intact, i.e. the cost of each
+// operation is proportional to the touched path (plus the tail of a patched array)
+
+Json & Json::patch(const Jnode & ops) {
+ // apply operations one by one: if any fails, all applied ones are rolled back (in
+ // the reverse order) - the document remains unchanged and the exception is rethrown
+ if(not ops.is_array()) throw EXP(Jnode::patch_bad_operation);
+ v_undo undo;
+ try {
+  for(auto & op: ops.children_())
+   patch_op_(op.VALUE, undo);
+ }
+ catch(...) {
+  for(auto it = undo.rbegin(); it != undo.rend(); ++it) (*it)();
+  throw;
+ }
+ return *this;
+}
+
+
+Json & Json::merge_patch(const Jnode & patch) {
+ merge_patch_(root(), patch);
+ return *this;
+}
+
+
+Json::v_str Json::pointer_(const std::string & ptr) const {
+ // split JSON Pointer (RFC 6901) into unescaped reference tokens ("" is the whole document)
+ v_str tokens;
+ if(ptr.empty()) return tokens;
+ if(ptr.front() != '/') throw EXP(Jnode::patch_bad_pointer);
+
+ for(auto c = ptr.begin(); c != ptr.end(); ++c)
+  if(*c == '/') tokens.emplace_back();
+  else if(*c != '~') tokens.back() += *c;
+  else if(++c != ptr.end() and (*c == '0' or *c == '1')) tokens.back() += *c == '0'? '~': '/';
+  else throw EXP(Jnode::patch_bad_pointer);
+ return tokens;
+}
+
+
+size_t Json::patch_index_(const Jnode & ary, const std::string & tkn, bool append) const {
+ // resolve reference token into array index, "-" (past the last element) is allowed
+ // only when appending
+ if(append and tkn == "-") return ary.children();
+ if(tkn.empty() or tkn.size() > 18 or (tkn.size() > 1 and tkn.front() == '0') or
+    tkn.find_first_not_of("0123456789") != std::string::npos)
+  throw EXP(Jnode::patch_path_not_found);
+ size_t idx = std::stoul(tkn);
+ if(idx > ary.children() or (idx == ary.children() and not append))
+  throw EXP(Jnode::patch_path_not_found);
+ return idx;
+}
+
+
+Jnode & Json::patch_node_(const v_str & path, size_t depth) {
+ // resolve first 'depth' tokens of the path accessing nodes for modification
+ Jnode * jn = &root();
+ for(size_t i = 0; i < depth; ++i)
+  if(jn->is_object()) {
+   if(jn->count(path[i]) == 0) throw EXP(Jnode::patch_path_not_found);
+   jn = &(*jn)[path[i]];
+  }
+  else if(jn->is_array())
+   jn = &(*jn)[static_cast<long>(patch_index_(*jn, path[i], false))];
+  else throw EXP(Jnode::patch_path_not_found);
+ return *jn;
+}
+
+
+const Jnode & Json::patch_get_(const v_str & path) const {
+ // resolve the path w/o modification
+ const Jnode * jn = &root();
+ for(auto & tkn: path)
+  if(jn->is_object()) {
+   if(jn->count(tkn) == 0) throw EXP(Jnode::patch_path_not_found);
+   jn = &(*jn)[tkn];
+  }
+  else if(jn->is_array())
+   jn = &(*jn)[static_cast<long>(patch_index_(*jn, tkn, false))];
+  else throw EXP(Jnode::patch_path_not_found);
+ return *jn;
+}
+
+
+void Json::patch_op_(const Jnode & op, v_undo & undo) {
+ auto member = [&](const char *name) -> const Jnode & {
+                if(not op.is_object() or op.count(name) == 0) throw EXP(Jnode::patch_bad_operation);
+                return op[name];
+               };
+ auto text = [&](const char *name) -> const std::string & {
+              auto & jn = member(name);
+              if(not jn.is_string()) throw EXP(Jnode::patch_bad_operation);
+              return jn.str();
+             };
+
+ const auto & name = text("op");
+ auto path = pointer_(text("path"));
+ DBG(0) DOUT() << "patch: " << name << " " << text("path") << std::endl;
+
+ if(name == "add") patch_add_(path, member("value"), undo);
+ else if(name == "remove") patch_remove_(path, undo);
+ else if(name == "replace") patch_replace_(path, member("value"), undo);
+ else if(name == "move") {
+  auto from = pointer_(text("from"));
+  if(from.size() < path.size() and std::equal(from.begin(), from.end(), path.begin()))
+   throw EXP(Jnode::patch_bad_operation);                              // cannot move into own child
+  patch_add_(path, patch_remove_(from, undo), undo);
+ }
+ else if(name == "copy") patch_add_(path, patch_get_(pointer_(text("from"))), undo);
+ else if(name == "test") {
+  if(patch_get_(path) != member("value")) throw EXP(Jnode::patch_test_failed);
+ }
+ else throw EXP(Jnode::patch_bad_operation);
+}
+
+
+void Json::patch_add_(const v_str & path, Jnode jn, v_undo & undo) {
+ // add a member into object (replace if exists), insert into array, or replace root
+ if(path.empty()) return patch_replace_(path, std::move(jn), undo);
+
+ auto & parent = patch_node_(path, path.size() - 1);
+ const auto & tkn = path.back();
+ if(parent.is_object()) {
+  if(parent.count(tkn) == 0)
+   undo.push_back([this, path]{ patch_node_(path, path.size() - 1).erase(path.back()); });
+  else
+   undo.push_back([this, path, old = parent[tkn]]{ patch_node_(path, path.size()) = old; });
+  parent[tkn] = std::move(jn);
+ }
+ else if(parent.is_array()) {
+  auto idx = patch_index_(parent, tkn, true);
+  parent.insert_(idx, std::move(jn));
+  undo.push_back([this, path, idx]{ patch_node_(path, path.size() - 1).extract_(idx); });
+ }
+ else throw EXP(Jnode::patch_path_not_found);
+}
+
+
+Jnode Json::patch_remove_(const v_str & path, v_undo & undo) {
+ // remove the node at the path and return it
+ if(path.empty()) throw EXP(Jnode::patch_bad_operation);               // root cannot be removed
+
+ auto & parent = patch_node_(path, path.size() - 1);
+ const auto & tkn = path.back();
+ Jnode jn;
+ if(parent.is_object()) {
+  if(parent.count(tkn) == 0) throw EXP(Jnode::patch_path_not_found);
+  jn = std::move(parent[tkn]);
+  parent.erase(tkn);
+ }
+ else if(parent.is_array())
+  jn = parent.extract_(patch_index_(parent, tkn, false));
+ else throw EXP(Jnode::patch_path_not_found);
+
+ undo.push_back([this, path, jn]{ v_undo ignored; patch_add_(path, jn, ignored); });
+ return jn;
+}
+
+
+void Json::patch_replace_(const v_str & path, Jnode jn, v_undo & undo) {
+ // replace existing node at the path
+ auto & node = patch_node_(path, path.size());
+ undo.push_back([this, path, old = std::move(node)]{ patch_node_(path, path.size()) = old; });
+ node = std::move(jn);
+}
+
+
+void Json::merge_patch_(Jnode & target, const Jnode & patch) {
+ // only nodes present in the patch are visited: null erases the member, an object
+ // is merged recursively, anything else replaces the target
+ if(not patch.is_object()) { target = patch; return; }
+ if(not target.is_object()) target = OBJ{};
+
+ for(auto & child: patch.children_())
+  if(child.VALUE.is_null()) target.erase(child.KEY);
+  else merge_patch_(target[child.KEY], child.VALUE);
+}
+
+
+
+
+
+//                      Jbin: CBOR and MessagePack readers
+//
+// binary JSON-like formats are decoded directly into the Jnode tree - the same one Json
+// parser builds (e.g., strings are held JSON-escaped, numbers as their text), so that
+// all Json facilities (walking, callbacks, printing) apply unchanged.
+// Conversion of types w/o JSON counterpart follows RFC 8949 (section 6.1):
+//  - byte strings (and MessagePack extensions) become base64url encoded strings
+//  - NaN, Infinity, undefined and other simple values become null
+//  - tags (CBOR) are dropped, while their content is retained
+//  - map keys which are not strings are converted into their JSON text
+// A sequence of top-level items (RFC 8742, or a MessagePack stream) is read as an array
+//
+//
+// SYNOPSIS:
+//
+//      Json json{ Jbin::from_cbor(bytes) };    // or: Jbin::from_msgpack(bytes)
+//
+//      switch(Jbin::detect(bytes, lim)) {      // guess the format of the input (limits apply)
+//       case Jbin::json: json.parse(bytes); break;
+//       case Jbin::cbor: json.root() = Jbin::from_cbor(bytes); break;
+//       case Jbin::msgpack: json.root() = Jbin::from_msgpack(bytes); break;
+//      }
+
+class Jbin {
+ public:
+    #define THROWREASON \
+                unexpected_end_of_input, \
+                invalid_encoding, \
+                unsupported_encoding, \
+                limit_depth_exceeded, \
+                limit_string_exceeded, \
+                limit_nodes_exceeded
+    ENUMSTR(ThrowReason, THROWREASON)
+
+    #define JBIN_FORMAT \
+                json, \
+                cbor, \
+                msgpack
+    ENUMSTR(Format, JBIN_FORMAT)
+
+    static Format       detect(const std::string & bin, const Json::Limits & lim = {});
+    static Jnode        from_cbor(const std::string & bin, const Json::Limits & lim = {})
+                         { return Jbin{bin, lim}.read_(&Jbin::cbor_); }
+    static Jnode        from_msgpack(const std::string & bin, const Json::Limits & lim = {})
+                         { return Jbin{bin, lim}.read_(&Jbin::msgpack_); }
+
+    EXCEPTIONS(ThrowReason)                                     // see "extensions.hpp"
+
+ private:
+    typedef void (Jbin::*Item)(Jnode &);                        // item decoder
+
+                        Jbin(const std::string & bin, const Json::Limits & lim):
+                         p_{reinterpret_cast<const uint8_t *>(bin.data())},
+                         e_{p_ + bin.size()}, lim_(lim) {}
+
+    Jnode               read_(Item item);
+    void                item_(Jnode & jn, Item item) {          // decode a value (or a key)
+                         if(lim_.nodes != 0 and ++nodes_ > lim_.nodes)
+                          throw EXP(limit_nodes_exceeded);
+                         (this->*item)(jn);
+                        }
+    void                nest_(void) {                           // enter iterable (or tag)
+                         if(lim_.depth != 0 and depth_ >= lim_.depth)
+                          throw EXP(limit_depth_exceeded);
+                         ++depth_;
+                        }
+    void                cbor_(Jnode & jn);
+    void                cbor_simple_(Jnode & jn, uint8_t info);
+    void                msgpack_(Jnode & jn);
+    void                iterable_(Jnode & jn, Jnode::Jtype type, uint64_t n, Item item);
+    void                string_(Jnode & jn, const uint8_t *s, uint64_t n);
+    void                bytes_(Jnode & jn, const uint8_t *s, uint64_t n);
+    void                number_(Jnode & jn, std::string && num);
+    void                float_(Jnode & jn, double d, int min_digits, int max_digits);
+    std::string         label_(const Jnode & key);
+    static std::string  key_(uint64_t idx) {                    // array's key (see next_key_)
+                         static const char hex[] = "0123456789abcdef";
+                         std::string key(ARRAY_LMT * 2, IDX_FIL);
+                         for(auto k = key.rbegin(); idx != 0; idx >>= 4) *k++ = hex[idx & 0xF];
+                         return key;
+                        }
+
+    uint8_t             byte_(void)
+                         { if(p_ == e_) throw EXP(unexpected_end_of_input); return *p_++; }
+    const uint8_t *     take_(uint64_t n) {                     // advance over n bytes
+                         if(n > static_cast<uint64_t>(e_ - p_))
+                          throw EXP(unexpected_end_of_input);
+                         p_ += n;
+                         return p_ - n;
+                        }
+    uint64_t            uint_(size_t bytes) {                   // big-endian unsigned
+                         auto s = take_(bytes);
+                         uint64_t x = 0;
+                         for(size_t i = 0; i < bytes; ++i) x = x << 8 | s[i];
+                         return x;
+                        }
+    bool                break_(void) {                          // CBOR "break" (0xFF)
+                         if(p_ == e_) throw EXP(unexpected_end_of_input);
+                         return *p_ == 0xFF? ++p_, true: false;
+                        }
+
+    const uint8_t *     p_;                                     // decoding point
+    const uint8_t *     e_;                                     // end of input
+    Json::Limits        lim_;                                   // resource limits (see Json)
+    size_t              depth_{0};                              // current nesting
+    size_t              nodes_{0};                              // values and keys decoded
+
+    static constexpr size_t
+                        probe_nodes_{1024};                     // detect() decodes at most
+};
+
+STRINGIFY(Jbin::ThrowReason, THROWREASON)
+#undef THROWREASON
+
+STRINGIFY(Jbin::Format, JBIN_FORMAT)
+#undef JBIN_FORMAT
+
+
+
+Jbin::Format Jbin::detect(const std::string & bin, const Json::Limits & lim) {
+ // JSON text starts with a printable character (or a blank); CBOR might be prefixed with
+ // the self-described tag (0xD9D9F7); otherwise the first byte is classified: CBOR maps
+ // (0xA0-0xBF) are MessagePack's fixstr, MessagePack's 16/32 bit arrays and maps
+ // (0xDC-0xDF) are invalid CBOR; ambiguous ones (e.g., MessagePack's fixmap is CBOR's
+ // array) are resolved by trial decoding of the first item as CBOR: the probe is bound by
+ // given limits and by own nodes budget (the item is CBOR if it's consistent that far)
+ if(bin.compare(0, 3, "\xD9\xD9\xF7") == 0) return cbor;
+ uint8_t b = bin.empty()? ' ': bin.front();
+ if((b >= ' ' and b < 0x7F) or b == '\t' or b == '\n' or b == '\r') return json;
+ if(b >= 0xA0 and b <= 0xBF) return cbor;
+ if(b >= 0xDC and b <= 0xDF) return msgpack;
+
+ Json::Limits probe_lim = lim;
+ bool nodes = lim.nodes == 0 or lim.nodes > probe_nodes_;
+ bool depth = lim.depth == 0 or lim.depth > probe_nodes_;       // (tags nest w/o nodes)
+ if(nodes) probe_lim.nodes = probe_nodes_;
+ if(depth) probe_lim.depth = probe_nodes_;
+ Jbin probe{bin, probe_lim};
+ try { Jnode jn; probe.item_(jn, &Jbin::cbor_); }
+ catch(stdException & e) {                                      // probe's own budget is spent
+  if(nodes and e.code() == limit_nodes_exceeded) return cbor;
+  if(depth and e.code() == limit_depth_exceeded) return cbor;
+  return msgpack;
+ }
+ return cbor;
+}
+
+
+Jnode Jbin::read_(Item item) {
+ // read all top-level items: a single item is returned as is, a sequence - as an array
+ Jnode ary{Jnode::Array};
+ auto & children = ary.children_();
+ size_t size = 1;
+ do {
+  Jnode jn;
+  item_(jn, item);
+  size += jn.size();
+  children.emplace_hint(children.end(), key_(children.size()), std::move(jn));
+ } while(p_ != e_);
+
+ if(children.size() == 1) return std::move(children.begin()->VALUE);
+ ary.sized_(size);
+ return ary;
+}
+
+
+void Jbin::cbor_(Jnode & jn) {
+ // decode CBOR data item (RFC 8949): initial byte holds major type and additional info
+ uint8_t ib = byte_(), major = ib >> 5, info = ib & 0x1F;
+ if(major == 7) return cbor_simple_(jn, info);
+
+ uint64_t n = info;
+ bool indefinite = info == 31;
+ if(info >= 24 and info <= 27) n = uint_(1 << (info - 24));    // 1, 2, 4 or 8 bytes argument
+ else if(info >= 28 and (info < 31 or major < 2 or major == 6))
+  throw EXP(invalid_encoding);
+
+ switch(major) {
+  case 0: return number_(jn, std::to_string(n));
+  case 1: return number_(jn, n == UINT64_MAX? "-18446744073709551616":
+                             "-" + std::to_string(n + 1));      // i.e.: -1 - n
+  case 2:
+  case 3:
+        if(indefinite) {                                        // concatenate definite chunks
+         std::string chunks;
+         while(not break_()) {
+          uint8_t cb = byte_(), ci = cb & 0x1F;
+          if(cb >> 5 != major or ci > 27) throw EXP(invalid_encoding);
+          uint64_t len = ci < 24? ci: uint_(1 << (ci - 24));
+          chunks.append(reinterpret_cast<const char *>(take_(len)), len);
+         }
+         auto s = reinterpret_cast<const uint8_t *>(chunks.data());
+         return major == 2? bytes_(jn, s, chunks.size()): string_(jn, s, chunks.size());
+        }
+        if(major == 2) return bytes_(jn, take_(n), n);
+        return string_(jn, take_(n), n);
+  case 4:
+  case 5:
+        return iterable_(jn, major == 4? Jnode::Array: Jnode::Object,
+                         indefinite? UINT64_MAX: std::min(n, UINT64_MAX - 1), &Jbin::cbor_);
+  default:                                                      // 6: tag, decode tagged item
+        nest_();                                                // tags nest too (recursion)
+        cbor_(jn);
+        --depth_;
+ }
+}
+
+
+void Jbin::cbor_simple_(Jnode & jn, uint8_t info) {
+ // major type 7: simple values and floats
+ switch(info) {
+  case 20:
+  case 21: jn.type_ = Jnode::Bool; jn.value_ = info == 21? CHR_TRUE: CHR_FALSE; return;
+  case 25: {                                                    // half-precision float
+        uint16_t h = uint_(2);
+        int exp = (h >> 10) & 0x1F, mant = h & 0x3FF;
+        double d = exp == 0? std::ldexp(mant, -24):
+                   exp != 31? std::ldexp(mant + 1024, exp - 25):
+                   mant == 0? INFINITY: NAN;
+        return float_(jn, h & 0x8000? -d: d, 3, 5);
+       }
+  case 26: {                                                    // single-precision float
+        uint32_t x = uint_(4);
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        return float_(jn, f, 6, 9);
+       }
+  case 27: {                                                    // double-precision float
+        uint64_t x = uint_(8);
+        double d;
+        memcpy(&d, &x, sizeof(d));
+        return float_(jn, d, 15, 17);
+       }
+  case 24: take_(1);                                            // simple value (one byte),
+                                                                // fall through
+  default:
+        if(info >= 28) throw EXP(invalid_encoding);             // including unexpected break
+        jn.type_ = Jnode::Null;                                 // null, undefined, unassigned
+ }
+}
+
+
+void Jbin::msgpack_(Jnode & jn) {
+ // decode MessagePack object: the first byte holds either the type, or a fix-type with
+ // embedded value/size
+ uint8_t b = byte_();
+ if(b <= 0x7F) return number_(jn, std::to_string(b));          // positive fixint
+ if(b >= 0xE0) return number_(jn, std::to_string(static_cast<int8_t>(b)));  // negative fixint
+ if(b <= 0x8F) return iterable_(jn, Jnode::Object, b & 0x0F, &Jbin::msgpack_);  // fixmap
+ if(b <= 0x9F) return iterable_(jn, Jnode::Array, b & 0x0F, &Jbin::msgpack_);   // fixarray
+ if(b <= 0xBF) return string_(jn, take_(b & 0x1F), b & 0x1F);  // fixstr
+
+ uint64_t n;
+ switch(b) {
+  case 0xC0: jn.type_ = Jnode::Null; return;
+  case 0xC2:
+  case 0xC3: jn.type_ = Jnode::Bool; jn.value_ = b == 0xC3? CHR_TRUE: CHR_FALSE; return;
+  case 0xC4:
+  case 0xC5:
+  case 0xC6: n = uint_(1 << (b - 0xC4)); return bytes_(jn, take_(n), n);   // bin 8/16/32
+  case 0xC7:
+  case 0xC8:
+  case 0xC9: n = uint_(1 << (b - 0xC7)); take_(1);              // ext 8/16/32 (type dropped)
+             return bytes_(jn, take_(n), n);
+  case 0xCA: {
+        uint32_t x = uint_(4);
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        return float_(jn, f, 6, 9);
+       }
+  case 0xCB: {
+        uint64_t x = uint_(8);
+        double d;
+        memcpy(&d, &x, sizeof(d));
+        return float_(jn, d, 15, 17);
+       }
+  case 0xCC:
+  case 0xCD:
+  case 0xCE:
+  case 0xCF: return number_(jn, std::to_string(uint_(1 << (b - 0xCC))));  // uint 8/16/32/64
+  case 0xD0: return number_(jn, std::to_string(static_cast<int8_t>(uint_(1))));
+  case 0xD1: return number_(jn, std::to_string(static_cast<int16_t>(uint_(2))));
+  case 0xD2: return number_(jn, std::to_string(static_cast<int32_t>(uint_(4))));
+  case 0xD3: return number_(jn, std::to_string(static_cast<int64_t>(uint_(8))));
+  case 0xD4:
+  case 0xD5:
+  case 0xD6:
+  case 0xD7:
+  case 0xD8: n = 1 << (b - 0xD4); take_(1);                     // fixext 1/2/4/8/16
+             return bytes_(jn, take_(n), n);
+  case 0xD9:
+  case 0xDA:
+  case 0xDB: n = uint_(1 << (b - 0xD9)); return string_(jn, take_(n), n);  // str 8/16/32
+  case 0xDC:
+  case 0xDD: return iterable_(jn, Jnode::Array, uint_(2 << (b - 0xDC)), &Jbin::msgpack_);
+  case 0xDE:
+  case 0xDF: return iterable_(jn, Jnode::Object, uint_(2 << (b - 0xDE)), &Jbin::msgpack_);
+  default: throw EXP(invalid_encoding);                         // 0xC1 is never used
+ }
+}
+
+
+void Jbin::iterable_(Jnode & jn, Jnode::Jtype type, uint64_t n, Item item) {
+ // decode n elements (object's key/value pairs) of array (object); n == UINT64_MAX stands
+ // for CBOR's indefinite length (elements are followed by break)
+ bool indefinite = n == UINT64_MAX;
+ if(not indefinite and n > static_cast<uint64_t>(e_ - p_))      // each element takes a byte
+  throw EXP(unexpected_end_of_input);                           // at least
+
+ nest_();
+ jn.type_ = type;
+ auto & children = jn.children_();
+ size_t size = 1;
+ for(uint64_t i = 0; indefinite? not break_(): i < n; ++i) {
+  Jnode key, value;
+  if(type == Jnode::Object) item_(key, item);
+  item_(value, item);
+  size_t value_size = value.size();
+  if(type == Jnode::Object) {
+   if(children.emplace(label_(key), std::move(value)).second) size += value_size;
+  }
+  else
+   { children.emplace_hint(children.end(), key_(i), std::move(value)); size += value_size; }
+ }
+ jn.sized_(size);
+ --depth_;
+}
+
+
+void Jbin::string_(Jnode & jn, const uint8_t *s, uint64_t n) {
+ // store string JSON-escaped (the same way the parser holds it)
+ static const char hex[] = "0123456789abcdef";
+ if(lim_.string != 0 and n > lim_.string) throw EXP(limit_string_exceeded);
+ jn.type_ = Jnode::String;
+ jn.value_.reserve(n);
+ for(auto e = s + n; s != e; ++s)
+  switch(*s) {
+   case '"': jn.value_ += "\\\""; break;
+   case '\\': jn.value_ += "\\\\"; break;
+   case '\b': jn.value_ += "\\b"; break;
+   case '\f': jn.value_ += "\\f"; break;
+   case '\n': jn.value_ += "\\n"; break;
+   case '\r': jn.value_ += "\\r"; break;
+   case '\t': jn.value_ += "\\t"; break;
+   default:
+        if(*s >= ' ') { jn.value_ += *s; break; }
+        jn.value_ += "\\u00";
+        jn.value_ += hex[*s >> 4];
+        jn.value_ += hex[*s & 0xF];
+  }
+}
+
+
+void Jbin::bytes_(Jnode & jn, const uint8_t *s, uint64_t n) {
+ // byte string is converted into base64url string w/o padding (RFC 8949, 6.1)
+ static const char b64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+ if(lim_.string != 0 and (n * 4 + 2) / 3 > lim_.string) throw EXP(limit_string_exceeded);
+ jn.type_ = Jnode::String;
+ jn.value_.reserve((n * 4 + 2) / 3);
+ for(uint64_t i = 0; i < n; i += 3) {
+  uint32_t x = s[i] << 16 | (i + 1 < n? s[i + 1] << 8: 0) | (i + 2 < n? s[i + 2]: 0);
+  for(uint64_t c = 0; c < 4 and i * 4 / 3 + c < (n * 4 + 2) / 3; ++c)
+   jn.value_ += b64[(x >> (18 - 6 * c)) & 0x3F];
+ }
+}
+
+
+void Jbin::number_(Jnode & jn, std::string && num) {
+ jn.type_ = Jnode::Number;
+ jn.value_ = std::move(num);
+}
+
+
+void Jbin::float_(Jnode & jn, double d, int min_digits, int max_digits) {
+ // NaN and Infinity become null, otherwise use the shortest precision which restores
+ // the value (up to the precision of the encoded float)
+ if(not std::isfinite(d)) { jn.type_ = Jnode::Null; return; }
+ char buf[32];
+ for(int digits = min_digits; digits <= max_digits; ++digits) {
+  snprintf(buf, sizeof(buf), "%.*g", digits, d);
+  double r = strtod(buf, nullptr);
+  if(max_digits == 17? r == d: static_cast<float>(r) == static_cast<float>(d)) break;
+ }
+ number_(jn, buf);
+}
+
+
+std::string Jbin::label_(const Jnode & key) {
+ // map key into object's label: strings as they are, atomic values as their JSON text
+ switch(key.type_) {
+  case Jnode::String: return key.value_;
+  case Jnode::Number: return key.value_;
+  case Jnode::Bool: return key.value_.front() == CHR_TRUE? STR_TRUE: STR_FALSE;
+  case Jnode::Null: return STR_NULL;
+  default: throw EXP(unsupported_encoding);                     // iterables as keys
+ }
+}
+
+
+
+
+
+
+//                      Jtape: an immutable, pre-order ("tape") layout of a JSON document
+//
+// Jnode tree is a pointer-linked structure (nodes are scattered across the heap), thus
+// read-only traversals of large documents are bound by cache misses. Jtape lays out all
+// nodes in a single contiguous array (in the document's pre-order), each entry carries a
+// skip offset (number of entries in its subtree), so that a whole subtree could be jumped
+// over in O(1), while labels and atomic values are held in a separate string buffer.
+// Jtape is built from a Jnode (or parsed from a string) and converts back into the
+// mutable Jnode tree on demand.
+//
+// Walks over the tape support a subset of Json's walk lexemes:
+//  - subscripts: [label], [n] (n-th child), [+n] (all children starting from n-th)
+//  - searches: <text> (strings), <text>d (numbers), <text>l (labels), followed by an
+//    optional quantifier: n (n-th match, the default is 0), +n (all matches from n-th)
+// searches look in the subtree of the node they start from (an atomic node is matched
+// itself), other lexemes throw walk_unsupported_lexeme
+//
+//
+// SYNOPSIS:
+//
+//      Jtape tape(json.root());            // or: Jtape tape(R"({ "a": [1, 2, 3] })");
+//
+//      std::cout << tape.root()["a"][1].num() << std::endl;
+//      for(auto child: tape.root()["a"])   // immediate children, subtrees are skipped
+//       std::cout << child << std::endl;
+//      for(auto & node: tape.walk("<a>l [+0]"))
+//       std::cout << node << std::endl;
+//
+//      tape.traverse([](const Jtape::Node &node, size_t depth) {   // pre-order, return
+//                     return not node.has_label() or node.label() != "secret"; // false to
+//                    });                                           // skip the subtree
+//
+//      std::cout << tape << std::endl;     // printing follows Jnode's settings (pretty/raw)
+//      Jnode jn = tape.to_jnode();         // mutable tree again
+
+class Jtape {
+  friend std::ostream & operator<<(std::ostream & os, const Jtape & tape);
+
+ public:
+    typedef Jnode::Jtype Jtype;
+
+    struct Entry {                                              // a node on the tape
+        size_t              skip;                               // entries in the subtree (>=1)
+        size_t              children;                           // immediate children
+        size_t              label_ofs;                          // label (object members only)
+        size_t              label_len;
+        size_t              value_ofs;                          // atomic value
+        size_t              value_len;
+        Jtype               type;
+        bool                labeled;                            // entry is an object's member
+    };
+
+    #define THROWREASON \
+                empty_tape, \
+                type_non_iterable, \
+                type_non_indexable, \
+                type_non_subscriptable, \
+                index_out_of_range, \
+                label_not_found, \
+                label_of_unlabeled_node, \
+                expected_atomic_type, \
+                expected_string_type, \
+                expected_number_type, \
+                expected_boolean_type, \
+                walk_unsupported_lexeme, \
+                walk_unterminated_lexeme
+    ENUMSTR(ThrowReason, THROWREASON)
+
+    class Node;
+    class Iterator;
+
+                        Jtape(void) = default;
+    explicit            Jtape(const Jnode & jn) { build(jn); }
+    explicit            Jtape(const std::string & json) { build(Json(json).root()); }
+
+    Jtape &             build(const Jnode & jn) {
+                         tape_.clear();
+                         str_.clear();
+                         append_(jn.value(), nullptr);
+                         return *this;
+                        }
+
+    Node                root(void) const;
+    size_t              size(void) const { return tape_.size(); }
+    bool                empty(void) const { return tape_.empty(); }
+    const Entry &       entry(size_t idx) const { return tape_[idx]; }
+    Jnode               to_jnode(void) const { return empty()? Jnode{}: to_jnode_(0); }
+
+                        // pre-order traversal, callback returns false to skip the subtree
+    void                traverse(std::function<bool(const Node &, size_t)> cb) const;
+    std::vector<Node>   walk(const std::string & wstr) const;   // nodes matched by a walk
+
+    EXCEPTIONS(ThrowReason)                                     // see "extensions.hpp"
+
+ private:
+    struct Lexeme {                                             // parsed walk lexeme
+        char                kind;                               // '[' index, '{' label, '<'
+        char                suffix;                             // search suffix ('\0', l, d)
+        std::string         text;
+        size_t              offset;                             // n: subscript or quantifier
+        bool                iterable;                           // +n
+    };
+
+    void                append_(const Jnode & jn, const std::string * label);
+    Jnode               to_jnode_(size_t idx) const;
+    std::ostream &      print_(std::ostream & os, size_t idx, int & rl) const;
+    size_t              store_(const std::string & s)
+                         { str_ += s; return str_.size() - s.size(); }
+    bool                equal_(size_t ofs, size_t len, const std::string & s) const
+                         { return len == s.size() and str_.compare(ofs, len, s) == 0; }
+    Lexeme              lexeme_(std::string::const_iterator & wp,
+                                std::string::const_iterator we) const;
+    void                step_(size_t idx, const Lexeme & lx, std::vector<size_t> & next) const;
+    bool                matched_(size_t idx, const Lexeme & lx) const;
+
+    std::vector<Entry>  tape_;                                  // nodes in pre-order
+    std::string         str_;                                   // labels and atomic values
+};
+
+STRINGIFY(Jtape::ThrowReason, THROWREASON)
+#undef THROWREASON
+
+
+
+class Jtape::Node {
+ // a light handle of a node on the tape (valid as long as the tape is)
+  friend class Jtape;
+  friend class Iterator;
+  friend std::ostream & operator<<(std::ostream & os, const Node & node)
+                         { return node.print_(os); }
+
+ public:
+                        Node(const Jtape * tp, size_t idx): tp_{tp}, idx_{idx} {}
+
+    Jtype               type(void) const { return e_().type; }
+    bool                is_object(void) const { return type() == Jnode::Object; }
+    bool                is_array(void) const { return type() == Jnode::Array; }
+    bool                is_string(void) const { return type() == Jnode::String; }
+    bool                is_number(void) const { return type() == Jnode::Number; }
+    bool                is_bool(void) const { return type() == Jnode::Bool; }
+    bool                is_null(void) const { return type() == Jnode::Null; }
+    bool                is_iterable(void) const { return type() <= Jnode::Array; }
+    bool                is_atomic(void) const { return type() > Jnode::Array; }
+
+    size_t              size(void) const { return e_().skip; }  // entire subtree size
+    size_t              children(void) const { return e_().children; }
+    bool                empty(void) const { return is_iterable() and children() == 0; }
+    size_t              position(void) const { return idx_; }   // index on the tape
+
+    bool                has_label(void) const { return e_().labeled; }
+    std::string         label(void) const {
+                         if(not has_label()) throw tp_->EXP(label_of_unlabeled_node);
+                         return tp_->str_.substr(e_().label_ofs, e_().label_len);
+                        }
+    std::string         val(void) const {
+                         if(is_iterable()) throw tp_->EXP(expected_atomic_type);
+                         return tp_->str_.substr(e_().value_ofs, e_().value_len);
+                        }
+    std::string         str(void) const {
+                         if(not is_string()) throw tp_->EXP(expected_string_type);
+                         return val();
+                        }
+    double              num(void) const {
+                         if(not is_number()) throw tp_->EXP(expected_number_type);
+                         return stod(val());
+                        }
+    bool                bul(void) const {
+                         if(not is_bool()) throw tp_->EXP(expected_boolean_type);
+                         return tp_->str_[e_().value_ofs] == CHR_TRUE;
+                        }
+
+    Iterator            begin(void) const;
+    Iterator            end(void) const;
+    Node                operator[](size_t i) const;
+    Node                operator[](const std::string & l) const;
+    Jnode               to_jnode(void) const { return tp_->to_jnode_(idx_); }
+
+ private:
+    const Entry &       e_(void) const { return tp_->tape_[idx_]; }
+    std::ostream &      print_(std::ostream & os) const
+                         { int rl{0}; return tp_->print_(os, idx_, rl); }
+
+    const Jtape *       tp_;
+    size_t              idx_;
+};
+
+
+
+class Jtape::Iterator: public std::iterator<std::forward_iterator_tag, Jtape::Node> {
+ // iterates over immediate children by jumping over their subtrees
+ public:
+                        Iterator(const Jtape * tp, size_t idx): node_{tp, idx} {}
+
+    const Node &        operator*(void) const { return node_; }
+    const Node *        operator->(void) const { return &node_; }
+    Iterator &          operator++(void) { node_.idx_ += node_.size(); return *this; }
+    Iterator            operator++(int) { auto it = *this; ++*this; return it; }
+    bool                operator==(const Iterator & r) const { return node_.idx_ == r.node_.idx_; }
+    bool                operator!=(const Iterator & r) const { return not operator==(r); }
+
+ private:
+    Node                node_;
+};
+
+
+
+std::ostream & operator<<(std::ostream & os, const Jtape & tape)
+ { return os << tape.root(); }
+
+
+Jtape::Node Jtape::root(void) const {
+ if(empty()) throw EXP(empty_tape);
+ return {this, 0};
+}
+
+
+Jtape::Iterator Jtape::Node::begin(void) const {
+ if(is_atomic()) throw tp_->EXP(type_non_iterable);
+ return {tp_, idx_ + 1};                                        // first child follows parent
+}
+
+
+Jtape::Iterator Jtape::Node::end(void) const {
+ if(is_atomic()) throw tp_->EXP(type_non_iterable);
+ return {tp_, idx_ + size()};                                   // next after the subtree
+}
+
+
+Jtape::Node Jtape::Node::operator[](size_t i) const {
+ if(is_atomic()) throw tp_->EXP(type_non_indexable);
+ if(i >= children()) throw tp_->EXP(index_out_of_range);
+ auto it = begin();
+ while(i-- > 0) ++it;
+ return *it;
+}
+
+
+Jtape::Node Jtape::Node::operator[](const std::string & l) const {
+ // labels are laid out in the sorted order (as in Jnode), but a linear scan with skips
+ // is cheap enough on the tape
+ if(not is_object()) throw tp_->EXP(type_non_subscriptable);
+ for(auto it = begin(); it != end(); ++it)
+  if(tp_->equal_(it->e_().label_ofs, it->e_().label_len, l)) return *it;
+ throw tp_->EXP(label_not_found);
+}
+
+
+void Jtape::traverse(std::function<bool(const Node &, size_t)> cb) const {
+ // pre-order walk over the tape, subtrees are skipped when cb returns false
+ std::vector<size_t> ends;                                      // end positions of open parents
+ for(size_t i = 0; i < tape_.size();) {
+  while(not ends.empty() and i >= ends.back()) ends.pop_back();
+  if(not cb(Node{this, i}, ends.size()))
+   { i += tape_[i].skip; continue; }
+  if(tape_[i].type <= Jnode::Array) ends.push_back(i + tape_[i].skip);
+  ++i;
+ }
+}
+
+
+std::vector<Jtape::Node> Jtape::walk(const std::string & wstr) const {
+ // evaluate walk lexemes one by one: each maps the current set of nodes into the next one
+ if(empty()) throw EXP(empty_tape);
+ std::vector<size_t> nodes{0}, next;
+ for(auto wp = wstr.cbegin(); ; nodes.swap(next)) {
+  while(wp != wstr.cend() and isspace(*wp)) ++wp;
+  if(wp == wstr.cend()) break;
+  auto lx = lexeme_(wp, wstr.cend());
+  next.clear();
+  for(auto idx: nodes)
+   step_(idx, lx, next);
+ }
+
+ std::vector<Node> found;
+ for(auto idx: nodes) found.emplace_back(this, idx);
+ return found;
+}
+
+
+Jtape::Lexeme Jtape::lexeme_(std::string::const_iterator & wp,
+                             std::string::const_iterator we) const {
+ // parse a lexeme: [text] or <text>, followed (searches only) by suffix and quantifier
+ Lexeme lx{*wp, '\0', "", 0, false};
+ if(lx.kind != '[' and lx.kind != '<') throw EXP(walk_unsupported_lexeme);
+ char closing = lx.kind == '['? ']': '>';
+ for(++wp; wp != we and *wp != closing; ++wp) {
+  if(*wp == '\\' and std::next(wp) != we) ++wp;                // escaped character
+  lx.text += *wp;
+ }
+ if(wp == we) throw EXP(walk_unterminated_lexeme);
+ ++wp;
+
+ auto number = [&lx](std::string::const_iterator & p, std::string::const_iterator e) {
+                if(p != e and *p == '+') { lx.iterable = true; ++p; }
+                for(; p != e and isdigit(*p); ++p) lx.offset = lx.offset * 10 + *p - '0';
+                return p == e;
+               };
+ if(lx.kind == '[') {                                           // [+n], [n] or [label]
+  auto p = lx.text.cbegin();
+  if(lx.text.empty() or lx.text.front() == '-' or lx.text.front() == '^')
+   throw EXP(walk_unsupported_lexeme);                          // parents and root offsets
+  if(not number(p, lx.text.cend()) or (lx.iterable and lx.text.size() == 1))
+   { lx.offset = 0; lx.iterable = false; lx.kind = '{'; }       // a label
+  return lx;
+ }
+
+ if(wp != we and isalpha(*wp)) {                                // search suffix
+  if(*wp != 'l' and *wp != 'd') throw EXP(walk_unsupported_lexeme);
+  lx.suffix = *wp++;
+ }
+ auto qe = wp;                                                  // quantifier ends at a space
+ while(qe != we and not isspace(*qe) and *qe != '[' and *qe != '<') ++qe;
+ if(not number(wp, qe)) throw EXP(walk_unsupported_lexeme);
+ return lx;
+}
+
+
+void Jtape::step_(size_t idx, const Lexeme & lx, std::vector<size_t> & next) const {
+ // apply lexeme to the node at idx, collect resulting nodes into next
+ Node node{this, idx};
+ if(lx.kind == '{') {                                           // [label]
+  if(not node.is_object()) return;
+  for(auto it = node.begin(); it != node.end(); ++it)
+   if(equal_(it->e_().label_ofs, it->e_().label_len, lx.text))
+    { next.push_back(it->idx_); return; }
+  return;
+ }
+ if(lx.kind == '[') {                                           // [n], [+n]
+  if(node.is_atomic() or lx.offset >= node.children()) return;
+  auto it = node.begin();
+  for(size_t i = 0; i < lx.offset; ++i) ++it;
+  for(; it != node.end(); ++it)
+   { next.push_back(it->idx_); if(not lx.iterable) return; }
+  return;
+ }
+
+ if(node.is_atomic() and lx.suffix == 'l') return;               // search: skip to quantifier
+ size_t n = 0, first = node.is_atomic()? idx: idx + 1;
+ for(size_t i = first; i < idx + tape_[idx].skip; ++i)
+  if(matched_(i, lx) and n++ >= lx.offset) {
+   next.push_back(i);
+   if(not lx.iterable) return;
+  }
+}
+
+
+bool Jtape::matched_(size_t idx, const Lexeme & lx) const {
+ const Entry & e = tape_[idx];
+ if(lx.suffix == 'l')
+  return e.labeled and equal_(e.label_ofs, e.label_len, lx.text);
+ if(e.type != (lx.suffix == 'd'? Jnode::Number: Jnode::String)) return false;
+ return equal_(e.value_ofs, e.value_len, lx.text);
+}
+
+
+void Jtape::append_(const Jnode & jn, const std::string * label) {
+ // lay out node and (recursively) its subtree in pre-order
+ size_t idx = tape_.size();
+ tape_.push_back(Entry{1, 0, 0, 0, 0, 0, jn.type(), label != nullptr});
+ if(label != nullptr) {
+  tape_[idx].label_ofs = store_(*label);
+  tape_[idx].label_len = label->size();
+ }
+ if(jn.is_atomic()) {
+  tape_[idx].value_ofs = store_(jn.val());
+  tape_[idx].value_len = jn.val().size();
+  return;
+ }
+ tape_[idx].children = jn.children();
+ for(auto & child: jn.children_())
+  append_(child.VALUE, jn.is_object()? &child.KEY: nullptr);
+ tape_[idx].skip = tape_.size() - idx;                          // now the subtree is laid out
+}
+
+
+Jnode Jtape::to_jnode_(size_t idx) const {
+ // build a mutable subtree off the tape (arrays are re-indexed)
+ const Entry & e = tape_[idx];
+ Jnode jn{e.type};
+ if(e.type > Jnode::Array)
+  { jn.value_ = str_.substr(e.value_ofs, e.value_len); return jn; }
+
+ auto & children = jn.children_();
+ for(size_t i = idx + 1, end = idx + e.skip; i < end; i += tape_[i].skip)
+  children.emplace_hint(children.end(), e.type == Jnode::Object?
+                         str_.substr(tape_[i].label_ofs, tape_[i].label_len): jn.next_key_(),
+                        to_jnode_(i));
+ jn.sized_(e.skip);
+ return jn;
+}
+
+
+std::ostream & Jtape::print_(std::ostream & os, size_t idx, int & rl) const {
+ // print the node at idx in the same format as Jnode::print_json_()
+ const Entry & e = tape_[idx];
+ char endl = Jnode::endl_;
+ switch(e.type) {
+  case Jnode::Object:
+  case Jnode::Array:
+        os << (e.type == Jnode::Object? JSN_OBJ_OPN: JSN_ARY_OPN);
+        if(e.children == 0) return os << (e.type == Jnode::Object? JSN_OBJ_CLS: JSN_ARY_CLS);
+        os << endl;
+        break;
+  case Jnode::Bool:
+        return os << (str_[e.value_ofs] == CHR_TRUE? STR_TRUE: STR_FALSE);
+  case Jnode::Null:
+        return os << STR_NULL;
+  case Jnode::Number:
+        return os.write(str_.data() + e.value_ofs, e.value_len);
+  case Jnode::String:
+        os << JSN_STRQ;
+        return os.write(str_.data() + e.value_ofs, e.value_len) << JSN_STRQ;
+  default:
+        return os;
+ }
+
+ if(endl == PRINT_PRT) ++rl;
+ for(size_t i = idx + 1, end = idx + e.skip; i < end; i += tape_[i].skip) {
+  os << std::string(rl * Jnode::tab_, ' ');
+  if(e.type == Jnode::Object) {
+   os << JSN_STRQ;
+   os.write(str_.data() + tape_[i].label_ofs, tape_[i].label_len) << JSN_STRQ << ": ";
+  }
+  print_(os, i, rl) << (i + tape_[i].skip != end? ",": "") << endl;
+ }
+ if(rl > 1) os << std::string((rl-1) * Jnode::tab_, ' ');
+ os << (e.type == Jnode::Object? JSN_OBJ_CLS: JSN_ARY_CLS);
+ if(endl == PRINT_PRT) --rl;
+ return os;
+}
+
+
+
 
 
 #undef DBG_WIDTH
@@ -62,6 +62,9 @@
  * //  - string is empty
  * //  - blob is empty (0 size)
  *
+ * // BlobView could be read instead of Blob - that way blob data are not copied, but the
+ * // view is valid only until the next row is read (or statement is reset/finalized)
+ *
  *
  * 5. SQLIO interface:
  *
@@ -114,12 +117,60 @@
  *  Row.. idx:2, str:"second line", rank:0.2, blob.size():0
  *  Row.. idx:3, str:"third line", rank:0.3, blob.size():24
  *
+ *
+ * 7. Sharing connection:
+ *
+ *  // an Sqlite object holds only one compiled statement at a time; to keep a few statements
+ *  // compiled over the same db (and transaction) other objects may share its connection:
+ *
+ *  Sqlite other;
+ *  other.share(db).compile("INSERT INTO another_table VALUES (?,?)");
+ *  other << 1 << "first line";             // goes within db's transaction (if any)
+ *
+ *  // shared connection is never closed (nor its transaction is ended) by the sharing object
+ *
+ *
+ * 8. Row source (bulk insert):
+ *
+ *  // rows kept in memory could be inserted in bulk by a single statement, without binding
+ *  // each value: a RowSource is registered as an eponymous virtual table, which reads
+ *  // (text) values directly from the held rows:
+ *
+ *  Sqlite::RowSource rs{2};                // row source with 2 columns
+ *  db.row_source("my_rows", rs);           // register it in db as virtual table "my_rows"
+ *
+ *  db.begin_transaction()
+ *    .prepare("INSERT INTO a_table (Description, Rank) SELECT * FROM my_rows");
+ *  rs.rows = {{"fourth line", "0.4"}, {"fifth line", "0.5"}};
+ *  db.execute();                           // all rows are inserted at once
+ *  rs.rows.clear();                        // re-fill rows and re-execute as needed...
+ *
+ *  // RowSource must outlive db (its connection); rows in the range [first, last) are read
+ *  // only, thus the range could be narrowed to re-execute statement over a part of rows
+ *  // NOTE: such statement has neither parameters, nor columns, thus compile() would
+ *  //       execute it right away (over whatever rows are held then), prepare() does not
+ *
+ *
+ * 9. Bulk load tuning:
+ *
+ *  // sqlite could be configured (process wide, before any db is opened) with a page cache
+ *  // and memory settings tuned for append-heavy bulk loads:
+ *
+ *  if(Sqlite::tune_for_bulk_load() != SQLITE_OK) ...   // too late: sqlite is initialized
+ *
+ *  // pages then are carved out of preallocated slabs (no malloc per page) and the least
+ *  // recently used pages are evicted first, so recently appended (b-tree leaf) pages stay
+ *  // cached; memory statistics (a mutex per malloc) are turned off, lookaside is enlarged
+ *
  */
 #pragma once
 
 #include <sqlite3.h>
 #include <string>
 #include <memory>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
 #include <type_traits>
 #include "macrolib.h"
 #include "extensions.hpp"
@@ -159,6 +210,7 @@ class Sqlite {
                          swap(l.cc_, r.cc_);
                          swap(l.sne_, r.sne_);
                          swap(l.lsql_, r.lsql_);
+                         swap(l.shared_, r.shared_);
                         }
 
  public:
@@ -173,6 +225,7 @@ class Sqlite {
                 could_not_reset_compiled_ctatement, \
                 could_not_bind_parameter, \
                 could_not_clear_bindings, \
+                could_not_create_module, \
                 EndOfRows
     ENUMSTR(ThrowReason, THROWREASON)
 
@@ -217,13 +270,18 @@ class Sqlite {
     Sqlite &            open(const std::string &fn,
                              int flags=SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE);
     Sqlite &            close(Throwing = may_throw);
+    Sqlite &            share(Sqlite &db);                      // use db's connection
+    bool                is_shared(void) const { return shared_; }
     sqlite3 **          dbp(void) { return & dbp_; };
     Sqlite &            begin_transaction(void);
     Sqlite &            end_transaction(Throwing = may_throw);
     Sqlite &            compile(const std::string &str);
+    Sqlite &            prepare(const std::string &str);        // compile w/o auto-execution
     Sqlite &            reset(void);
     Sqlite &            finalize(void);
+    Sqlite &            execute(void) { return exec_(); }       // re-execute w/o bindings
     int                 rc(void) { return rc_; }
+    int                 changes(void) { return sqlite3_changes(dbp_); } // rows by last write
 
 
     typedef std::vector<std::string> v_string;
@@ -244,6 +302,20 @@ class Sqlite {
                          { headers_.clear(); htypes_.clear(); hdtypes_.clear(); return *this; }
 
 
+    // row source (eponymous virtual table over rows held in memory):
+    typedef std::vector<v_string> v_rows;
+    struct RowSource {
+        size_t          columns;                                // number of columns
+        v_rows          rows;                                   // rows of (text) values
+        size_t          first{0};                               // range of rows to be read:
+        size_t          last{SIZE_MAX};                         // [first, last)
+    };
+    Sqlite &            row_source(const std::string &name, RowSource &rs);
+
+    // process wide sqlite configuration (must precede opening any db)
+  static int            tune_for_bulk_load(size_t slab_pages = 256);
+
+
     // OUTPUT Storage Classes:
     template<typename T>
     Sqlite &            write(const T &val) { return operator<<(val); }
@@ -286,6 +358,7 @@ class Sqlite {
     Sqlite &            operator>>(double &i);                  // REAL
     Sqlite &            operator>>(std::string &i);             // TEXT
     Sqlite &            operator>>(class Blob &b);              // BLOB
+    Sqlite &            operator>>(class BlobView &b);          // BLOB w/o copying (see below)
 
     template<typename T>                                        // custom types with SQLIO
     typename
@@ -323,6 +396,32 @@ class Sqlite {
     Sqlite &            exec_(void);
     void                maybeRecompileCachedSql_(void);
 
+    struct RsTab_ {                                             // row source vtab
+        sqlite3_vtab    base;
+        RowSource *     rs;
+    };
+    struct RsCursor_ {                                          // row source cursor
+        sqlite3_vtab_cursor base;
+        size_t          row;
+    };
+  static int            rs_connect_(sqlite3 *db, void *aux, int argc, const char * const *argv,
+                                    sqlite3_vtab **vtab, char **err);
+  static int            rs_best_index_(sqlite3_vtab *, sqlite3_index_info *info);
+  static int            rs_disconnect_(sqlite3_vtab *vtab)
+                         { delete reinterpret_cast<RsTab_*>(vtab); return SQLITE_OK; }
+  static int            rs_open_(sqlite3_vtab *, sqlite3_vtab_cursor **cursor)
+                         { *cursor = &(new RsCursor_{})->base; return SQLITE_OK; }
+  static int            rs_close_(sqlite3_vtab_cursor *cursor)
+                         { delete reinterpret_cast<RsCursor_*>(cursor); return SQLITE_OK; }
+  static int            rs_filter_(sqlite3_vtab_cursor *cursor, int, const char *,
+                                   int, sqlite3_value **);
+  static int            rs_next_(sqlite3_vtab_cursor *cursor)
+                         { ++reinterpret_cast<RsCursor_*>(cursor)->row; return SQLITE_OK; }
+  static int            rs_eof_(sqlite3_vtab_cursor *cursor);
+  static int            rs_column_(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int i);
+  static int            rs_rowid_(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid)
+                         { *rowid = reinterpret_cast<RsCursor_*>(cursor)->row; return SQLITE_OK; }
+
     sqlite3 *           dbp_{nullptr};                          // dp ptr
     sqlite3_stmt *      ppStmt_{nullptr};                       // pointer to a prepared statement
 
@@ -339,6 +438,7 @@ class Sqlite {
     int                 cc_{0};                                 // column count
     bool                sne_{false};                            // skip next exec_()
     std::string         lsql_;                                  // cached last sql statement
+    bool                shared_{false};                         // connection is borrowed
 };
 
 STRINGIFY(Sqlite::ThrowReason, THROWREASON)
@@ -376,6 +476,13 @@ Sqlite & Sqlite::open(const std::string &filename, int flags) {
 
 
 Sqlite & Sqlite::close(Throwing throwing) {
+ if(shared_) {                                                  // borrowed connection is left
+  finalize();                                                   // intact, only own statement is
+  dbp_ = nullptr;                                               // finalized
+  shared_ = false;
+  ts_ = out_of_transaction;
+  return *this;
+ }
  if(ts_ != out_of_transaction) end_transaction(throwing);
  finalize();
  const char * fn{nullptr};
@@ -390,6 +497,20 @@ Sqlite & Sqlite::close(Throwing throwing) {
 
 
 
+Sqlite & Sqlite::share(Sqlite &db) {
+ // share db's connection: statements compiled here are independent from db's one, but run
+ // in db's transaction (if db is in transaction), which is never ended by this object; db
+ // must outlive this object
+ if(dbp_) close();
+ dbp_ = db.dbp_;
+ shared_ = true;
+ ts_ = db.ts_ == out_of_transaction? out_of_transaction: in_transaction_precompiled;
+ DBG(1) DOUT() << "sharing connection, tr/rc: " << ts_ << '/' << rc_ << std::endl;
+ return *this;
+}
+
+
+
 Sqlite & Sqlite::begin_transaction(void) {
  // 0 = out of transaction;
  // 1 = transaction is open but no SQL statement is compiled
@@ -431,7 +552,18 @@ Sqlite & Sqlite::end_transaction(Throwing throwing) {
 
 
 Sqlite & Sqlite::compile(const std::string &sql) {
- // compile user sql statement
+ // compile user sql statement, a statement w/o parameters and columns (i.e. neither
+ // bound, nor read) is executed right away
+ prepare(sql);
+ if(pc_!=0 or cc_!=0) return *this;                             // defer execution until R/W ops.
+ DBG(2) DOUT() << "auto-executing SQL statement..." << std::endl;
+ return exec_();                                                // auto exec statement
+}
+
+
+
+Sqlite & Sqlite::prepare(const std::string &sql) {
+ // compile user sql statement (to be executed by R/W ops, or explicitly by execute())
  if(ts_ == in_transaction_compiled)                             // considered to be a user error
   throw EXP(must_not_recompile_while_in_transaction);
 
@@ -450,10 +582,7 @@ Sqlite & Sqlite::compile(const std::string &sql) {
  ci_ = 0;
  cc_ = column_count();
  DBG(2) DOUT() << "column/parameter count in compiled: " << cc_ << '/' << pc_ << std::endl;
-
- if(pc_!=0 or cc_!=0) return *this;                             // defer execution until R/W ops.
- DBG(2) DOUT() << "auto-executing SQL statement..." << std::endl;
- return exec_();                                                // auto exec statement
+ return *this;
 }
 
 
@@ -485,6 +614,77 @@ Sqlite & Sqlite::finalize(void) {
 
 
 
+Sqlite & Sqlite::row_source(const std::string &name, RowSource &rs) {
+ // register rows source as an eponymous-only virtual table (xCreate is null)
+ static const sqlite3_module module{
+  0, nullptr, rs_connect_, rs_best_index_, rs_disconnect_, rs_disconnect_,
+  rs_open_, rs_close_, rs_filter_, rs_next_, rs_eof_, rs_column_, rs_rowid_
+ };
+ rc_ = sqlite3_create_module_v2(dbp_, name.c_str(), &module, &rs, nullptr);
+ DBG(1) DOUT() << "registered row source '" << name << "', rc: " << rc_ << std::endl;
+ if(rc_ != SQLITE_OK)
+  throw EXP(could_not_create_module);
+ return *this;
+}
+
+
+
+int Sqlite::rs_connect_(sqlite3 *db, void *aux, int, const char * const *,
+                        sqlite3_vtab **vtab, char **) {
+ // declare vtab with columns c0, c1, ...
+ auto rs = static_cast<RowSource*>(aux);
+ std::string schema{"CREATE TABLE x("};
+ for(size_t i = 0; i < rs->columns; ++i)
+  schema += (i == 0? "c": ",c") + std::to_string(i);
+ schema += ")";
+
+ int rc = sqlite3_declare_vtab(db, schema.c_str());
+ if(rc != SQLITE_OK) return rc;
+ *vtab = &(new RsTab_{{}, rs})->base;
+ return SQLITE_OK;
+}
+
+
+
+int Sqlite::rs_best_index_(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+ // rows source is scanned only
+ auto rs = reinterpret_cast<RsTab_*>(vtab)->rs;
+ info->estimatedCost = rs->rows.size();
+ info->estimatedRows = rs->rows.size();
+ return SQLITE_OK;
+}
+
+
+
+int Sqlite::rs_filter_(sqlite3_vtab_cursor *cursor, int, const char *, int, sqlite3_value **) {
+ auto rs = reinterpret_cast<RsTab_*>(cursor->pVtab)->rs;
+ reinterpret_cast<RsCursor_*>(cursor)->row = rs->first;
+ return SQLITE_OK;
+}
+
+
+
+int Sqlite::rs_eof_(sqlite3_vtab_cursor *cursor) {
+ auto rs = reinterpret_cast<RsTab_*>(cursor->pVtab)->rs;
+ auto row = reinterpret_cast<RsCursor_*>(cursor)->row;
+ return row >= rs->last or row >= rs->rows.size();
+}
+
+
+
+int Sqlite::rs_column_(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int i) {
+ // values are handed over w/o copying: rows must not change while statement is stepped
+ auto rs = reinterpret_cast<RsTab_*>(cursor->pVtab)->rs;
+ auto & row = rs->rows[reinterpret_cast<RsCursor_*>(cursor)->row];
+ if(static_cast<size_t>(i) >= row.size())                       // short row, pad with NULL
+  sqlite3_result_null(ctx);
+ else
+  sqlite3_result_text(ctx, row[i].c_str(), row[i].size(), SQLITE_STATIC);
+ return SQLITE_OK;
+}
+
+
+
 Sqlite & Sqlite::operator<<(std::nullptr_t x) {
  maybeRecompileCachedSql_();
  rc_ = sqlite3_bind_null(ppStmt_, pi_);
@@ -540,7 +740,7 @@ Sqlite::operator<<(F d) {
 
 Sqlite & Sqlite::operator<<(const std::string &str) {
  maybeRecompileCachedSql_();
- rc_ = sqlite3_bind_text(ppStmt_, pi_, str.c_str(), -1, SQLITE_TRANSIENT);
+ rc_ = sqlite3_bind_text(ppStmt_, pi_, str.data(), str.size(), SQLITE_TRANSIENT);
  DBG(3)
   DOUT() << "created text parameter binding " << pi_
          << ", tr/rc: " << ts_ << '/' << rc_ << std::endl;
@@ -614,6 +814,25 @@ Sqlite & Sqlite::operator>>(std::string &str) {
 
 
 
+Sqlite & Sqlite::operator>>(class BlobView &blob) {
+ // zero-copy read: view points into sqlite's own column memory, which remains valid only
+ // until the next read (step), reset() or finalize() of the statement - hence view must
+ // be consumed (restored from) before reading any next row
+ if(ci_ == 0) {                                                 // all columns read, read next row
+  if(rc_ == SQLITE_DONE) return *this;                          // prior read returned SQLITE_DONE
+  if(exec_().rc() != SQLITE_ROW) return *this;
+ }
+ const void *ptr = sqlite3_column_blob(ppStmt_, ci_);           // must precede column_bytes
+ blob.view(ptr, sqlite3_column_bytes(ppStmt_, ci_));
+ DBG(3)
+  DOUT() << "blob viewed from column " << ci_
+         << ", tr/rc: " << ts_ <<'/'<< rc_ << std::endl;
+ ci_ = (ci_+1) % cc_;
+ return *this;
+}
+
+
+
 Sqlite & Sqlite::operator>>(class Blob &blob) {
  if(ci_ == 0) {                                                 // all columns read, read next row
   if(rc_ == SQLITE_DONE) return *this;                          // prior read returned SQLITE_DONE
@@ -710,6 +929,241 @@ void Sqlite::maybeRecompileCachedSql_(void) {
 
 
 
+class SqliteSlabCache {
+ // PCACHE2 page cache tuned for bulk loads (see "Bulk load tuning" notes): pages are carved
+ // out of preallocated slabs and recycled via a free list (no malloc per page); unpinned
+ // pages are kept in LRU order and the least recently used is evicted first
+ public:
+  static const sqlite3_pcache_methods2 *
+                        methods(size_t slab_pages);
+
+ private:
+    struct Page {
+        sqlite3_pcache_page base;                               // pBuf and pExtra follow Page
+        unsigned        key;
+        bool            pinned;
+        Page *          prev;                                   // LRU list of unpinned pages
+        Page *          next;                                   // (or a free list)
+    };
+
+    struct Cache {
+        size_t          hdr;                                    // aligned Page size
+        size_t          slot;                                   // hdr + aligned page + extra size
+        int             sz_page;
+        int             sz_extra;
+        bool            purgeable;
+        size_t          max{0};                                 // cache size (in pages)
+        size_t          slab_pages;
+        std::vector<std::unique_ptr<char[]>>
+                        slabs;
+        size_t          carved{0};                              // slots used in the last slab
+        Page *          free{nullptr};                          // free pages (via next)
+        Page *          mru{nullptr};                           // most recently unpinned
+        Page *          lru{nullptr};                           // least recently unpinned
+        std::unordered_map<unsigned, Page*>
+                        pages;
+
+        Page *          allocate(void);
+        void            unlink(Page *p);                        // remove from LRU list
+        void            discard(Page *p);                       // drop page into free list
+        void            evict(size_t limit);                    // evict LRU pages above limit
+    };
+
+  static size_t         slab_pages_;
+
+  static int            init_(void *) { return SQLITE_OK; }
+  static void           shutdown_(void *) {}
+  static sqlite3_pcache *
+                        create_(int sz_page, int sz_extra, int purgeable);
+  static void           cachesize_(sqlite3_pcache *c, int n);
+  static int            pagecount_(sqlite3_pcache *c)
+                         { return reinterpret_cast<Cache*>(c)->pages.size(); }
+  static sqlite3_pcache_page *
+                        fetch_(sqlite3_pcache *c, unsigned key, int create);
+  static void           unpin_(sqlite3_pcache *c, sqlite3_pcache_page *p, int discard);
+  static void           rekey_(sqlite3_pcache *c, sqlite3_pcache_page *p,
+                               unsigned old_key, unsigned new_key);
+  static void           truncate_(sqlite3_pcache *c, unsigned limit);
+  static void           destroy_(sqlite3_pcache *c) { delete reinterpret_cast<Cache*>(c); }
+  static void           shrink_(sqlite3_pcache *c)
+                         { reinterpret_cast<Cache*>(c)->evict(0); }
+};
+
+size_t SqliteSlabCache::slab_pages_{256};
+
+
+
+const sqlite3_pcache_methods2 * SqliteSlabCache::methods(size_t slab_pages) {
+ static const sqlite3_pcache_methods2 m{
+  1, nullptr, init_, shutdown_, create_, cachesize_, pagecount_,
+  fetch_, unpin_, rekey_, truncate_, destroy_, shrink_
+ };
+ slab_pages_ = slab_pages == 0? 1: slab_pages;
+ return &m;
+}
+
+
+
+sqlite3_pcache * SqliteSlabCache::create_(int sz_page, int sz_extra, int purgeable) {
+ auto c = new(std::nothrow) Cache;
+ if(c == nullptr) return nullptr;
+ constexpr size_t a = alignof(std::max_align_t);
+ c->hdr = (sizeof(Page) + a - 1) / a * a;
+ c->slot = c->hdr + (sz_page + sz_extra + a - 1) / a * a;
+ c->sz_page = sz_page;
+ c->sz_extra = sz_extra;
+ c->purgeable = purgeable;
+ c->slab_pages = slab_pages_;
+ return reinterpret_cast<sqlite3_pcache*>(c);
+}
+
+
+
+void SqliteSlabCache::cachesize_(sqlite3_pcache *cache, int n) {
+ auto c = reinterpret_cast<Cache*>(cache);
+ c->max = n < 0? 0: n;
+ if(c->purgeable) c->evict(c->max);
+}
+
+
+
+sqlite3_pcache_page * SqliteSlabCache::fetch_(sqlite3_pcache *cache, unsigned key, int create) {
+ // createFlag: 0 - don't allocate, 1 - allocate if easy, 2 - make every effort to allocate
+ auto c = reinterpret_cast<Cache*>(cache);
+ auto found = c->pages.find(key);
+ if(found != c->pages.end()) {
+  Page *p = found->second;
+  if(not p->pinned) { c->unlink(p); p->pinned = true; }
+  return &p->base;
+ }
+ if(create == 0) return nullptr;
+
+ Page *p{nullptr};
+ if(c->purgeable and c->pages.size() >= c->max) {               // cache is full
+  if(c->lru == nullptr and create == 1) return nullptr;         // all pinned, let sqlite spill
+  if(c->lru != nullptr) {                                       // recycle least recently used
+   p = c->lru;
+   c->unlink(p);
+   c->pages.erase(p->key);
+  }
+ }
+ if(p == nullptr and (p = c->allocate()) == nullptr) return nullptr;
+
+ p->key = key;
+ p->pinned = true;
+ memset(p->base.pExtra, 0, c->sz_extra);                        // sqlite expects zeroed extra
+ c->pages[key] = p;
+ return &p->base;
+}
+
+
+
+void SqliteSlabCache::unpin_(sqlite3_pcache *cache, sqlite3_pcache_page *page, int discard) {
+ auto c = reinterpret_cast<Cache*>(cache);
+ auto p = reinterpret_cast<Page*>(page);
+ p->pinned = false;
+ if(discard)
+  { c->pages.erase(p->key); return c->discard(p); }
+ p->prev = nullptr;                                             // becomes the most recently used
+ p->next = c->mru;
+ if(c->mru) c->mru->prev = p; else c->lru = p;
+ c->mru = p;
+ if(c->purgeable) c->evict(c->max);                             // cache might have outgrown
+}
+
+
+
+void SqliteSlabCache::rekey_(sqlite3_pcache *cache, sqlite3_pcache_page *page,
+                             unsigned old_key, unsigned new_key) {
+ auto c = reinterpret_cast<Cache*>(cache);
+ auto found = c->pages.find(new_key);                           // prior page with new_key (never
+ if(found != c->pages.end()) {                                  // pinned) is discarded
+  Page *p = found->second;
+  c->pages.erase(found);
+  if(not p->pinned) c->unlink(p);
+  c->discard(p);
+ }
+ auto p = reinterpret_cast<Page*>(page);
+ c->pages.erase(old_key);
+ p->key = new_key;
+ c->pages[new_key] = p;
+}
+
+
+
+void SqliteSlabCache::truncate_(sqlite3_pcache *cache, unsigned limit) {
+ // discard all pages with keys >= limit (pinned pages are implicitly unpinned)
+ auto c = reinterpret_cast<Cache*>(cache);
+ for(auto it = c->pages.begin(); it != c->pages.end();) {
+  if(it->first < limit) { ++it; continue; }
+  Page *p = it->second;
+  it = c->pages.erase(it);
+  if(not p->pinned) c->unlink(p);
+  c->discard(p);
+ }
+}
+
+
+
+SqliteSlabCache::Page * SqliteSlabCache::Cache::allocate(void) {
+ // take a page from free list, otherwise carve it out of the slab
+ if(free != nullptr)
+  { Page *p = free; free = p->next; return p; }
+
+ if(slabs.empty() or carved == slab_pages) {
+  slabs.emplace_back(new(std::nothrow) char[slot * slab_pages]);
+  if(slabs.back() == nullptr) { slabs.pop_back(); return nullptr; }
+  carved = 0;
+ }
+ char *ptr = slabs.back().get() + slot * carved++;
+ Page *p = reinterpret_cast<Page*>(ptr);
+ p->base.pBuf = ptr + hdr;
+ p->base.pExtra = static_cast<char*>(p->base.pBuf) + sz_page;
+ return p;
+}
+
+
+
+void SqliteSlabCache::Cache::unlink(Page *p) {
+ (p->prev? p->prev->next: mru) = p->next;
+ (p->next? p->next->prev: lru) = p->prev;
+}
+
+
+
+void SqliteSlabCache::Cache::discard(Page *p) {
+ p->next = free;
+ free = p;
+}
+
+
+
+void SqliteSlabCache::Cache::evict(size_t limit) {
+ while(lru != nullptr and pages.size() > limit) {
+  Page *p = lru;
+  unlink(p);
+  pages.erase(p->key);
+  discard(p);
+ }
+}
+
+
+
+
+
+int Sqlite::tune_for_bulk_load(size_t slab_pages) {
+ // configure sqlite for bulk loads, must be called before sqlite is initialized (i.e. before
+ // opening any db), otherwise SQLITE_MISUSE is returned
+ int rc = sqlite3_config(SQLITE_CONFIG_PCACHE2, SqliteSlabCache::methods(slab_pages));
+ if(rc != SQLITE_OK) return rc;
+ rc = sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 0);               // no mutex per malloc
+ if(rc != SQLITE_OK) return rc;
+ return sqlite3_config(SQLITE_CONFIG_LOOKASIDE, 1200, 256);     // more small allocs w/o malloc
+}
+
+
+
+
 
 
 